@@ -57,7 +57,7 @@ static inline void
 parallel_sample_sortBTCEUA(string* strings, size_t n)
 {
     parallel_sample_sort_base<
-        bingmann_sample_sort::ClassifyEqualUnrollAssembler>(
+        bingmann_sample_sort::ClassifyEqualBranchlessX>(
         UCharStringSet(strings, strings + n), 0);
 }
 
@@ -71,6 +71,106 @@ parallel_sample_sortBTCTUI(string* strings, size_t n)
         UCharStringSet(strings, strings + n), 0);
 }
 
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortBTCT128(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyTreeCalcUnrollInterleave128X>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortBTCTG(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyTreeCalcGatherX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortKTC(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyKaryTreeX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+static inline void
+parallel_sample_sortKTC16(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyKaryTree16X>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortLC(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyLearnedX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortRL(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyRadixLookupX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+static inline void
+parallel_sample_sortRL_ws(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyRadixLookupX,
+        jobqueue::WorkStealingJobQueueGroup>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+static inline void
+parallel_sample_sortRL_prio(string* strings, size_t n)
+{
+    parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyRadixLookupX,
+        jobqueue::PriorityJobQueueGroup>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+static inline void
+parallel_sample_sortRL_sorter(string* strings, size_t n)
+{
+    // persistent thread pool and Context, reused by consecutive runs
+    static Sorter<bingmann_sample_sort::ClassifyRadixLookupX> sorter;
+    sorter.sort(strings, n);
+}
+
+static inline void
+parallel_sample_sortRL_async(string* strings, size_t n)
+{
+    // shared pool threads, the sort is enqueued and awaited
+    static AsyncSorter<bingmann_sample_sort::ClassifyRadixLookupX> sorter;
+    sorter.sort_base(UCharStringSet(strings, strings + n)).get();
+}
+
+static inline void
+parallel_sample_sortRL_inplace(string* strings, size_t n)
+{
+    parallel_sample_sort_inplace_base<
+        bingmann_sample_sort::ClassifyRadixLookupX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
 /******************************************************************************/
 // Parallel Sample Sort with LCP Instantiations
 
@@ -88,7 +188,7 @@ static inline void
 parallel_sample_sortBTCEU_lcp(string* strings, size_t n)
 {
     parallel_sample_sort_lcp_base<
-        bingmann_sample_sort::ClassifyEqualUnrollAssembler>(
+        bingmann_sample_sort::ClassifyEqualBranchlessX>(
         UCharStringSet(strings, strings + n), 0);
 }
 
@@ -102,6 +202,65 @@ parallel_sample_sortBTCTUI_lcp(string* strings, size_t n)
         UCharStringSet(strings, strings + n), 0);
 }
 
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortBTCT128_lcp(string* strings, size_t n)
+{
+    parallel_sample_sort_lcp_base<
+        bingmann_sample_sort::ClassifyTreeCalcUnrollInterleave128X>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortBTCTG_lcp(string* strings, size_t n)
+{
+    parallel_sample_sort_lcp_base<
+        bingmann_sample_sort::ClassifyTreeCalcGatherX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortKTC_lcp(string* strings, size_t n)
+{
+    parallel_sample_sort_lcp_base<
+        bingmann_sample_sort::ClassifyKaryTreeX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortLC_lcp(string* strings, size_t n)
+{
+    parallel_sample_sort_lcp_base<
+        bingmann_sample_sort::ClassifyLearnedX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+static inline void
+parallel_sample_sortRL_lcp(string* strings, size_t n)
+{
+    parallel_sample_sort_lcp_base<
+        bingmann_sample_sort::ClassifyRadixLookupX>(
+        UCharStringSet(strings, strings + n), 0);
+}
+
+static inline void
+parallel_sample_sortRL_inplace_lcp(string* strings, size_t n)
+{
+    std::vector<uintptr_t> lcp(n);
+    parallel_sample_sort_inplace_lcp_base<
+        bingmann_sample_sort::ClassifyRadixLookupX>(
+        UCharStringSet(strings, strings + n), lcp.data(), 0);
+}
+
 } // namespace bingmann_parallel_sample_sort
 
 /******************************************************************************/
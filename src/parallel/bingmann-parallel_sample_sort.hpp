@@ -31,11 +31,16 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 
 #include "../tools/lcgrandom.hpp"
 #include "../tools/stringtools.hpp"
 #include "../tools/jobqueue.hpp"
 #include "../tools/lockfree.hpp"
+#include "../tools/cpu_features.hpp"
 
 #include "../sequential/inssort.hpp"
 #include "../sequential/bingmann-lcp_inssort.hpp"
@@ -44,6 +49,9 @@
 #include "../sequential/bingmann-sample_sortBTC.hpp"
 #include "../sequential/bingmann-sample_sortBTCE.hpp"
 #include "../sequential/bingmann-sample_sortBTCT.hpp"
+#include "../sequential/bingmann-sample_sortKTC.hpp"
+#include "../sequential/bingmann-sample_sortLC.hpp"
+#include "../sequential/bingmann-sample_sortRL.hpp"
 
 #include <tlx/string/hexdump.hpp>
 #include <tlx/die.hpp>
@@ -91,7 +99,8 @@ static const bool use_only_first_sortstep = PS5_SINGLE_STEP;
 //! maximum number of threads, used in a few static arrays
 static const size_t MAXPROCS = 2 * 64 + 1; // +1 due to round up of processor number
 
-//! L2 cache size, used to calculate classifier tree sizes
+//! L2 cache size, used to calculate classifier tree sizes if the size cannot
+//! be detected at runtime
 #ifndef PS5_L2CACHE
 #define PS5_L2CACHE     256 * 1024
 #endif
@@ -100,7 +109,56 @@ static const size_t l2cache = PS5_L2CACHE;
 static const size_t g_smallsort_threshold = 1024 * 1024;
 static const size_t g_inssort_threshold = 32;
 
-typedef uint64_t key_type;
+//! range of splitter tree sizes instantiated for runtime selection, in steps
+//! of two levels
+static const size_t g_treebits_min = 8;
+static const size_t g_treebits_max = 14;
+
+//! minimum expected bucket size when selecting the splitter tree size
+static const size_t g_treebits_min_bktsize = 64;
+
+//! maximum size in bytes of the blocks permuted by the in-place distribution
+static const size_t g_inplace_block_bytes = 1024;
+
+//! size in bytes of the per-bucket block buffers of one part of the in-place
+//! distribution, which limits the block size for large splitter trees.
+static const size_t g_inplace_buffer_bytes = 256 * 1024;
+
+//! number of strings classified at once by the in-place distribution
+static const size_t g_inplace_chunk = 1024;
+
+//! Select the number of splitter tree levels for a sample sort step on n
+//! strings: the largest instantiated tree whose splitters and bucket counters
+//! fit into half of the L2 cache, and whose buckets are expected to contain at
+//! least g_treebits_min_bktsize strings. g_ps5_treebits pins the choice.
+static inline size_t
+select_treebits(size_t n, size_t key_size, size_t bktsize_size)
+{
+    size_t treebits;
+
+    if (g_ps5_treebits != 0) {
+        // round down to an instantiated size
+        treebits = std::min(std::max(g_ps5_treebits, g_treebits_min),
+                            g_treebits_max);
+        return treebits - (treebits - g_treebits_min) % 2;
+    }
+
+    size_t budget = cpu_features::cache_size(2);
+    if (budget == 0) budget = l2cache;
+    budget /= 2;
+
+    for (treebits = g_treebits_max; treebits > g_treebits_min; treebits -= 2)
+    {
+        size_t numsplitters = (size_t(1) << treebits) - 1;
+        size_t memory = (numsplitters + 1) * key_size
+                        + (2 * numsplitters + 2) * bktsize_size;
+
+        if (memory <= budget && n >= (g_treebits_min_bktsize << treebits))
+            break;
+    }
+
+    return treebits;
+}
 
 // ****************************************************************************
 // *** Global Parallel Super Scalar String Sample Sort Context
@@ -126,6 +184,9 @@ public:
     //! counters
     size_t para_ss_steps, seq_ss_steps, bs_steps;
 
+    //! pool of job and step objects, with per-thread free lists
+    objectpool::ObjectPool objpool;
+
     //! type of job queue group (usually a No-Op Class)
     typedef JobQueueGroupType<Context> jobqueuegroup_type;
 
@@ -138,12 +199,63 @@ public:
     //! job queue
     jobqueue_type jobqueue;
 
+    //! executor processing the job queue, e.g. a resident ThreadPool, or NULL
+    //! for an OpenMP parallel region
+    threadpool::Executor* executor;
+
+    //! token to cancel the sort, or NULL
+    CancelToken* cancel;
+
+    //! set when a job found the sort cancelled and left strings unsorted
+    std::atomic<bool> aborted;
+
     //! context constructor
     Context(jobqueuegroup_type* jqg = NULL)
         : para_ss_steps(0), seq_ss_steps(0), bs_steps(0),
-          jobqueue(*this, jqg)
+          jobqueue(*this, jqg), executor(NULL), cancel(NULL), aborted(false)
     { }
 
+    //! check whether the sort is cancelled, called between steps and jobs.
+    //! Only tests a pointer if no CancelToken is set.
+    bool cancelled()
+    {
+        if (!cancel || !cancel->cancelled()) return false;
+
+        aborted.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    //! cheaper cancelled() for the frequent checks per bucket of the
+    //! sequential sorts, see CancelToken::poll().
+    bool cancel_poll()
+    {
+        if (!cancel || !cancel->poll()) return false;
+
+        aborted.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    //! number of job and step objects allocated from objpool
+    size_t objects_allocated() const
+    {
+        return objpool.allocated();
+    }
+
+    //! number of those which were not recycled but needed a malloc()
+    size_t objects_malloced() const
+    {
+        return objpool.malloced();
+    }
+
+    //! process the job queue with threadnum threads
+    void loop()
+    {
+        if (executor)
+            jobqueue.loop(*executor, threadnum);
+        else
+            jobqueue.loop();
+    }
+
     //! return sequential sorting threshold
     size_t sequential_threshold()
     {
@@ -170,7 +282,8 @@ public:
 // ****************************************************************************
 // *** SortStep to Keep Track of Substeps
 
-class SortStep
+//! SortSteps are allocated from Context::objpool, see JobT.
+class SortStep : public objectpool::PooledObject
 {
 private:
     //! Number of substeps still running
@@ -206,25 +319,28 @@ public:
 // ****************************************************************************
 // *** Classification Variants
 
+template <typename KeyType>
 static inline unsigned char
-lcpKeyType(const key_type& a, const key_type& b)
+lcpKeyType(const KeyType& a, const KeyType& b)
 {
     // XOR both values and count the number of zero bytes
     return count_high_zero_bits(a ^ b) / 8;
 }
 
+template <typename KeyType>
 static inline unsigned char
-lcpKeyDepth(const key_type& a)
+lcpKeyDepth(const KeyType& a)
 {
     // count number of non-zero bytes
-    return sizeof(key_type) - (count_low_zero_bits(a) / 8);
+    return sizeof(KeyType) - (count_low_zero_bits(a) / 8);
 }
 
 //! return the d-th character in the (swapped) key
+template <typename KeyType>
 static inline unsigned char
-getCharAtDepth(const key_type& a, unsigned char d)
+getCharAtDepth(const KeyType& a, unsigned char d)
 {
-    return static_cast<unsigned char>(a >> (8 * (sizeof(key_type) - 1 - d)));
+    return static_cast<unsigned char>(a >> (8 * (sizeof(KeyType) - 1 - d)));
 }
 
 // ****************************************************************************
@@ -300,7 +416,10 @@ void sample_sort_lcp(const Classify& classifier,
     assert(!strptr.flipped());
     assert(strptr.check());
 
-    const typename StringPtr::StringSet& strset = strptr.output();
+    typedef typename Classify::key_type key_type;
+    typedef typename StringPtr::StringSet StringSet;
+
+    const StringSet& strset = strptr.output();
 
     size_t b = 0;         // current bucket number
     key_type prevkey = 0; // previous key
@@ -317,7 +436,8 @@ void sample_sort_lcp(const Classify& classifier,
         if (bkt[b] != bkt[b + 1])
         {
             prevkey = classifier.get_splitter(b / 2);
-            assert(prevkey == strset.get_uint64(strset.at(bkt[b + 1] - 1), depth));
+            assert(prevkey ==
+                   get_key<key_type>(strset, strset.at(bkt[b + 1] - 1), depth));
             break;
         }
         ++b;
@@ -325,7 +445,8 @@ even_first:
         // even bucket: <, << or > bkt
         if (bkt[b] != bkt[b + 1])
         {
-            prevkey = strset.get_uint64(strset.at(bkt[b + 1] - 1), depth);
+            prevkey =
+                get_key<key_type>(strset, strset.at(bkt[b + 1] - 1), depth);
             break;
         }
         ++b;
@@ -343,32 +464,467 @@ even_first:
         if (bkt[b] != bkt[b + 1])
         {
             key_type thiskey = classifier.get_splitter(b / 2);
-            assert(thiskey == strset.get_uint64(strset.at(bkt[b]), depth));
+            assert(thiskey ==
+                   get_key<key_type>(strset, strset.at(bkt[b]), depth));
 
             int rlcp = lcpKeyType(prevkey, thiskey);
             strptr.set_lcp(bkt[b], depth + rlcp);
             strptr.set_cache(bkt[b], getCharAtDepth(thiskey, rlcp));
 
             prevkey = thiskey;
-            assert(prevkey == strset.get_uint64(strset.at(bkt[b + 1] - 1), depth));
+            assert(prevkey ==
+                   get_key<key_type>(strset, strset.at(bkt[b + 1] - 1), depth));
         }
         ++b;
 even_bucket:
         // even bucket: <, << or > bkt
         if (bkt[b] != bkt[b + 1])
         {
-            key_type thiskey = strset.get_uint64(strset.at(bkt[b]), depth);
+            key_type thiskey =
+                get_key<key_type>(strset, strset.at(bkt[b]), depth);
 
             int rlcp = lcpKeyType(prevkey, thiskey);
             strptr.set_lcp(bkt[b], depth + rlcp);
             strptr.set_cache(bkt[b], getCharAtDepth(thiskey, rlcp));
 
-            prevkey = strset.get_uint64(strset.at(bkt[b + 1] - 1), depth);
+            prevkey =
+                get_key<key_type>(strset, strset.at(bkt[b + 1] - 1), depth);
         }
         ++b;
     }
 }
 
+// ****************************************************************************
+// *** Key Cache carried through the SampleSortStep levels
+
+//! Per-string key cache of SampleSortStep: the keys extracted for
+//! classification are stored in an array parallel to the string pointers, and
+//! permuted alongside them into a shadow key array. The recursive steps on the
+//! buckets can reuse them instead of reloading the keys from string memory.
+template <typename KeyType>
+class KeyCache
+{
+public:
+    typedef KeyType key_type;
+
+    //! keys of the active strings, and the shadow array they are moved to
+    key_type* active, * shadow;
+
+    //! depth at which the keys in active were extracted (-1 = none yet)
+    size_t depth;
+
+    //! construct a disabled key cache
+    KeyCache()
+        : active(NULL), shadow(NULL), depth(size_t(-1)) { }
+
+    KeyCache(key_type* active, key_type* shadow, size_t depth)
+        : active(active), shadow(shadow), depth(depth) { }
+
+    //! whether keys are cached at all
+    bool enabled() const { return active != NULL; }
+
+    //! key cache of the bucket at offset after distribution into shadow
+    KeyCache flip(size_t offset, size_t depth) const
+    {
+        if (!enabled()) return KeyCache();
+        return KeyCache(shadow + offset, active + offset, depth);
+    }
+
+    //! get the key of string i at depth d from the cache, if it can be derived
+    //! from the cached key: either the depth is unchanged, or the string ends
+    //! within the cached key, such that all following characters are zero.
+    bool get(size_t i, size_t d, key_type& key) const
+    {
+        if (d < depth) return false;
+
+        size_t shift = d - depth;
+        if (shift == 0) {
+            key = active[i];
+            return true;
+        }
+        if ((active[i] & 0xFF) == 0) {
+            key = shift < sizeof(key_type) ? active[i] << (8 * shift) : 0;
+            return true;
+        }
+        return false;
+    }
+};
+
+//! Minimal StringSet over an array of cached keys, to run the classifiers on
+//! keys instead of strings. The keys were extracted at the classification
+//! depth, hence it is ignored.
+template <typename KeyType>
+class KeyCacheSet
+{
+public:
+    typedef KeyType String;
+    typedef const KeyType* Iterator;
+
+    KeyCacheSet(Iterator begin, Iterator end)
+        : begin_(begin), end_(end) { }
+
+    Iterator begin() const { return begin_; }
+    Iterator end() const { return end_; }
+    size_t size() const { return end_ - begin_; }
+
+    uint64_t get_uint64(const String& s, size_t /* depth */) const
+    { return s; }
+
+    uint128_t get_uint128(const String& s, size_t /* depth */) const
+    { return s; }
+
+    void prefetch_string(const String&) const { }
+    void prefetch_chars(const String&, size_t) const { }
+
+protected:
+    Iterator begin_, end_;
+};
+
+// ****************************************************************************
+// *** In-Place Distribution by Block Permutation
+
+//! Distribution of strings into buckets within their array, without shadow
+//! array, in the style of IPS4o. The array is split into parts of whole blocks
+//! and processed in three phases, which each must be finished for all parts
+//! before the next starts:
+//!
+//! 1) classify() moves the strings of a part into per-bucket buffers of one
+//!    block, and writes full buffers as blocks to the front of the part.
+//!
+//! 2) permute() moves the blocks to the region of their bucket, after
+//!    prepare() collected all blocks at the front of the array. The region of
+//!    a bucket starts at its boundary rounded up to whole blocks.
+//!
+//! 3) cleanup() fills the gaps at the bucket boundaries with the strings left
+//!    in the buffers, after finish_permute() saved the ends of blocks reaching
+//!    over the boundary into the next bucket.
+template <typename StringSet>
+class BlockDistribution
+{
+public:
+    typedef typename StringSet::String String;
+    typedef typename StringSet::Iterator Iterator;
+
+    //! select the block size for bktnum buckets, such that the buffers of a
+    //! part fit into g_inplace_buffer_bytes.
+    static size_t select_block_size(size_t bktnum)
+    {
+        size_t block_size = g_inplace_buffer_bytes / (bktnum * sizeof(String));
+        block_size = std::min(block_size, g_inplace_block_bytes / sizeof(String));
+        return std::max(block_size, size_t(1));
+    }
+
+    //! split strset into at most parts parts of whole blocks
+    BlockDistribution(const StringSet& strset, size_t bktnum, size_t parts,
+                      size_t block_size)
+        : strset_(strset), n_(strset.size()), bktnum_(bktnum),
+          block_size_(block_size),
+          count_(parts * bktnum), blockend_(parts),
+          blockbkt_(n_ / block_size + 1), bktbegin_(bktnum + 1)
+    {
+        psize_ = round_block((n_ + parts - 1) / parts);
+        parts_ = (n_ + psize_ - 1) / psize_;
+        buffer_.resize(parts_, NULL);
+    }
+
+    ~BlockDistribution()
+    {
+        for (size_t p = 0; p < parts_; ++p)
+            delete[] buffer_[p];
+    }
+
+    //! non-copyable: owns the buffers
+    BlockDistribution(const BlockDistribution&) = delete;
+    BlockDistribution& operator = (const BlockDistribution&) = delete;
+
+    //! number of parts, each processed by one job in each phase
+    size_t parts() const { return parts_; }
+
+    //! boundary of bucket b after the distribution, b <= bktnum
+    size_t bucket_begin(size_t b) const { return bktbegin_[b]; }
+
+    // *** Phase 1
+
+    //! classify the strings of part p and collect them in the buffers. A full
+    //! buffer is written to the front of the part, which is always behind the
+    //! strings read so far.
+    template <typename Classify>
+    void classify(size_t p, const Classify& classifier, size_t depth)
+    {
+        Iterator strB = strset_.begin() + p * psize_;
+        Iterator strE = strset_.begin() + std::min((p + 1) * psize_, n_);
+
+        String* buffer = buffer_[p] = new String[bktnum_ * block_size_];
+        size_t* count = count_.data() + p * bktnum_;
+
+        Iterator out = strB;
+        uint16_t bktcache[g_inplace_chunk];
+
+        for (Iterator chunk = strB; chunk != strE; )
+        {
+            size_t size = std::min<size_t>(g_inplace_chunk, strE - chunk);
+            classifier.classify(strset_, chunk, chunk + size, bktcache, depth);
+
+            for (size_t i = 0; i < size; ++i, ++chunk)
+            {
+                uint16_t b = bktcache[i];
+                String* buf = buffer + b * block_size_;
+                size_t fill = count[b]++ % block_size_;
+
+                buf[fill] = std::move(*chunk);
+
+                if (fill + 1 == block_size_) {
+                    blockbkt_[(out - strset_.begin()) / block_size_] = b;
+                    out = std::move(buf, buf + block_size_, out);
+                }
+            }
+        }
+
+        blockend_[p] = out - strset_.begin();
+    }
+
+    //! return the buffered strings of part p after classify() to the end of
+    //! the part, which leaves the part permuted. No-op if not classified.
+    void restore(size_t p)
+    {
+        if (buffer_[p] == NULL) return;
+
+        Iterator out = strset_.begin() + blockend_[p];
+        for (size_t b = 0; b < bktnum_; ++b)
+        {
+            String* buf = buffer_[p] + b * block_size_;
+            out = std::move(buf, buf + count_[p * bktnum_ + b] % block_size_,
+                            out);
+        }
+        assert(out == strset_.begin() + std::min((p + 1) * psize_, n_));
+    }
+
+    // *** Phase 2
+
+    //! calculate the bucket boundaries and move the last full blocks into the
+    //! gaps behind the full blocks of the parts, until all are in front.
+    void prepare()
+    {
+        Iterator begin = strset_.begin();
+
+        size_t sum = 0;
+        for (size_t b = 0; b < bktnum_; ++b)
+        {
+            bktbegin_[b] = sum;
+            for (size_t p = 0; p < parts_; ++p)
+                sum += count_[p * bktnum_ + b];
+        }
+        assert(sum == n_);
+        bktbegin_[bktnum_] = n_;
+
+        size_t fullend = 0;
+        for (size_t p = 0; p < parts_; ++p)
+            fullend += blockend_[p] - p * psize_;
+
+        size_t q = parts_ - 1, qend = blockend_[q];
+
+        for (size_t p = 0; p * psize_ < fullend; ++p)
+        {
+            for (size_t gap = blockend_[p];
+                 gap < std::min((p + 1) * psize_, fullend); gap += block_size_)
+            {
+                while (qend <= std::max(q * psize_, fullend))
+                    qend = blockend_[--q];
+
+                qend -= block_size_;
+                std::move(begin + qend, begin + qend + block_size_, begin + gap);
+                blockbkt_[gap / block_size_] = blockbkt_[qend / block_size_];
+            }
+        }
+
+        blockptr_.reset(new BlockPointers[bktnum_]);
+        for (size_t b = 0; b < bktnum_; ++b)
+        {
+            blockptr_[b].write = round_block(bktbegin_[b]);
+            blockptr_[b].read = std::max(
+                blockptr_[b].write,
+                std::min(round_block(bktbegin_[b + 1]), fullend));
+        }
+
+        overflow_.reset(new String[block_size_]);
+        overflow_bkt_ = bktnum_;
+    }
+
+    //! move unprocessed blocks to the next free slot in the region of their
+    //! bucket, swapping with the block found there until a slot is empty.
+    void permute(size_t p)
+    {
+        Iterator begin = strset_.begin();
+
+        std::unique_ptr<String[]> swapbuf(new String[2 * block_size_]);
+        String* buf = swapbuf.get(), * tmp = buf + block_size_;
+
+        for (size_t k = 0; k < bktnum_; ++k)
+        {
+            uint16_t b;
+            while (read_block((p * bktnum_ / parts_ + k) % bktnum_, buf, b))
+            {
+                while (true)
+                {
+                    BlockPointers& bp = blockptr_[b];
+                    size_t slot;
+                    bool full;
+                    {
+                        std::unique_lock<std::mutex> lock(bp.mutex);
+                        slot = bp.write;
+                        bp.write += block_size_;
+                        full = (slot < bp.read);
+                    }
+
+                    if (full) {
+                        // swap with the unprocessed block in the slot
+                        uint16_t c = blockbkt_[slot / block_size_];
+                        std::move(begin + slot, begin + slot + block_size_, tmp);
+                        std::move(buf, buf + block_size_, begin + slot);
+                        std::swap(buf, tmp);
+                        b = c;
+                    }
+                    else if (slot + block_size_ > n_) {
+                        // only the last slot can reach past the end
+                        std::move(buf, buf + block_size_, overflow_.get());
+                        overflow_bkt_ = b;
+                        break;
+                    }
+                    else {
+                        std::move(buf, buf + block_size_, begin + slot);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    //! save the ends of the last blocks reaching over the bucket boundaries,
+    //! before the next buckets are filled up.
+    void finish_permute()
+    {
+        Iterator begin = strset_.begin();
+
+        if (overflow_bkt_ != bktnum_)
+            blockptr_[overflow_bkt_].write -= block_size_;
+
+        overhang_.reset(new String[bktnum_ * block_size_]);
+        for (size_t b = 0; b < bktnum_; ++b)
+        {
+            size_t from = std::max(bktbegin_[b + 1], round_block(bktbegin_[b]));
+            if (from < blockptr_[b].write) {
+                std::move(begin + from, begin + blockptr_[b].write,
+                          overhang_.get() + b * block_size_);
+            }
+        }
+    }
+
+    // *** Phase 3
+
+    //! fill the gaps before and after the blocks of the buckets of part p
+    //! with the buffered strings, the overhang and the overflow block.
+    void cleanup(size_t p)
+    {
+        Iterator begin = strset_.begin();
+
+        for (size_t b = p * bktnum_ / parts_;
+             b < (p + 1) * bktnum_ / parts_; ++b)
+        {
+            size_t bbegin = bktbegin_[b], bend = bktbegin_[b + 1];
+            size_t blocks = round_block(bbegin), write = blockptr_[b].write;
+
+            // gaps [bbegin,blocks) and [write,bend), clipped to the bucket
+            size_t pos = bbegin;
+            size_t gapend = std::min(blocks, bend);
+
+            auto fill = [&](String* from, size_t size) {
+                            while (size != 0) {
+                                if (pos == gapend) {
+                                    pos = std::max(blocks, std::min(write, bend));
+                                    gapend = bend;
+                                    assert(pos < gapend);
+                                }
+                                size_t m = std::min(size, gapend - pos);
+                                std::move(from, from + m, begin + pos);
+                                from += m, pos += m, size -= m;
+                            }
+                        };
+
+            size_t from = std::max(bend, blocks);
+            if (from < write)
+                fill(overhang_.get() + b * block_size_, write - from);
+            if (overflow_bkt_ == b)
+                fill(overflow_.get(), block_size_);
+            for (size_t q = 0; q < parts_; ++q)
+                fill(buffer_[q] + b * block_size_,
+                     count_[q * bktnum_ + b] % block_size_);
+        }
+    }
+
+protected:
+    //! strings to distribute
+    StringSet strset_;
+    size_t n_;
+
+    //! number of buckets and strings in a block
+    size_t bktnum_, block_size_;
+
+    //! number and size of the parts, psize_ is a multiple of block_size_
+    size_t parts_, psize_;
+
+    //! buffers of one block for each bucket, and their bucket sizes per part
+    std::vector<String*> buffer_;
+    std::vector<size_t> count_;
+
+    //! end of the full blocks written to the front of each part
+    std::vector<size_t> blockend_;
+    //! bucket of each full block before the permutation
+    std::vector<uint16_t> blockbkt_;
+
+    //! exclusive prefix sum of bucket sizes, i.e. the bucket boundaries
+    std::vector<size_t> bktbegin_;
+
+    //! write and read pointers of the block permutation in the region of a
+    //! bucket: [write,read) contains unprocessed full blocks.
+    struct BlockPointers
+    {
+        std::mutex mutex;
+        size_t     write, read;
+    };
+    std::unique_ptr<BlockPointers[]> blockptr_;
+
+    //! block written past the end of the array, and its bucket (or bktnum)
+    std::unique_ptr<String[]> overflow_;
+    size_t overflow_bkt_;
+
+    //! strings of the last block of each bucket reaching into the next bucket
+    std::unique_ptr<String[]> overhang_;
+
+    //! round i up to whole blocks
+    size_t round_block(size_t i) const
+    {
+        return (i + block_size_ - 1) / block_size_ * block_size_;
+    }
+
+    //! take an unprocessed block from the region of bucket b into buf, returns
+    //! false if there is none left.
+    bool read_block(size_t b, String* buf, uint16_t& bktid)
+    {
+        BlockPointers& bp = blockptr_[b];
+        std::unique_lock<std::mutex> lock(bp.mutex);
+
+        if (bp.read <= bp.write) return false;
+
+        // copy while locked: a writer may claim the slot right after
+        bp.read -= block_size_;
+        bktid = blockbkt_[bp.read / block_size_];
+
+        Iterator blk = strset_.begin() + bp.read;
+        std::move(blk, blk + block_size_, buf);
+        return true;
+    }
+};
+
 // ****************************************************************************
 // *** SampleSort non-recursive in-place sequential sample sort for small sorts
 
@@ -376,6 +932,12 @@ template <template <size_t> class Classify, typename Context, typename StringPtr
 void Enqueue(Context& ctx, SortStep* sstep,
              const StringPtr& strptr, size_t depth);
 
+template <template <size_t> class Classify, typename Context, typename StringPtr,
+          typename KeyType>
+void Enqueue(Context& ctx, SortStep* sstep,
+             const StringPtr& strptr, size_t depth,
+             const KeyCache<KeyType>& keycache);
+
 template <typename Context, template <size_t> class Classify,
           typename StringPtr, typename BktSizeType>
 class SmallsortJob : public Context::job_type, public SortStep
@@ -390,33 +952,86 @@ public:
     size_t in_depth;
 
     typedef typename StringPtr::StringSet StringSet;
+    typedef typename StringSet::String String;
 
     typedef BktSizeType bktsize_type;
 
+    //! key type of the classifier, also used for the MKQS key cache
+    typedef typename Classify<bingmann_sample_sort::DefaultTreebits>::key_type
+        key_type;
+
+    //! keys of the strings from the parent SampleSortStep (if enabled)
+    KeyCache<key_type> in_keycache;
+
     SmallsortJob(SortStep* pstep,
-                 const StringPtr& strptr, size_t depth)
-        : pstep(pstep), in_strptr(strptr), in_depth(depth)
+                 const StringPtr& strptr, size_t depth,
+                 const KeyCache<key_type>& keycache = KeyCache<key_type>())
+        : pstep(pstep), in_strptr(strptr), in_depth(depth),
+          in_keycache(keycache)
     { }
 
-    class SeqSampleSortStep
+    //! estimated work for PriorityJobStorage: the number of strings
+    size_t priority() const final
+    {
+        return in_strptr.size();
+    }
+
+    //! part of a sequential sample sort step independent of the splitter
+    //! tree size, which is processed by the recursion loop
+    class SeqSampleSortStepBase
     {
     public:
         StringPtr strptr;
         size_t idx;
         size_t depth;
 
-        Classify<bingmann_sample_sort::DefaultTreebits> classifier;
+        //! number of buckets, 2 * numsplitters + 1
+        size_t bktnum;
+
+        //! LCPs of splitters and bucket boundaries, kept in the derived class
+        unsigned char* splitter_lcp;
+        bktsize_type* bkt;
+
+        SeqSampleSortStepBase(const StringPtr& strptr, size_t depth,
+                              size_t bktnum, unsigned char* splitter_lcp,
+                              bktsize_type* bkt)
+            : strptr(strptr), idx(0), depth(depth),
+              bktnum(bktnum), splitter_lcp(splitter_lcp), bkt(bkt)
+        { }
+
+        //! non-copyable: splitter_lcp and bkt point into the object
+        SeqSampleSortStepBase(const SeqSampleSortStepBase&) = delete;
+        SeqSampleSortStepBase& operator = (const SeqSampleSortStepBase&) = delete;
+
+        virtual ~SeqSampleSortStepBase() { }
+
+        //! depth of the NULL-terminated key in the i-th equal bucket
+        virtual unsigned char splitter_depth(size_t i) const = 0;
+
+        virtual void calculate_lcp() = 0;
+    };
+
+    template <size_t TreeBits>
+    class SeqSampleSortStep : public SeqSampleSortStepBase
+    {
+    public:
+        using SeqSampleSortStepBase::strptr;
+        using SeqSampleSortStepBase::depth;
+
+        Classify<TreeBits> classifier;
 
-        static const size_t numsplitters =
-            Classify<bingmann_sample_sort::DefaultTreebits>::numsplitters;
+        static const size_t numsplitters = Classify<TreeBits>::numsplitters;
         static const size_t bktnum = 2 * numsplitters + 1;
 
-        unsigned char splitter_lcp[numsplitters + 1];
-        bktsize_type bkt[bktnum + 1];
+        //! LCPs of splitters, needed for recursive calls
+        unsigned char splitter_lcp_array[numsplitters + 1];
+        //! bucket boundaries after the distribution
+        bktsize_type bkt_array[bktnum + 1];
 
         SeqSampleSortStep(Context& ctx, const StringPtr& _strptr, size_t _depth,
                           uint16_t* bktcache)
-            : strptr(_strptr), idx(0), depth(_depth)
+            : SeqSampleSortStepBase(_strptr, _depth, bktnum,
+                                    splitter_lcp_array, bkt_array)
         {
             size_t n = strptr.size();
 
@@ -433,56 +1048,83 @@ public:
             LCGRandom rng(&samples);
 
             for (size_t i = 0; i < samplesize; ++i)
-                samples[i] = strset.get_uint64(strset[begin + rng() % n], depth);
+                samples[i] = get_key<key_type>(
+                    strset, strset[begin + rng() % n], depth);
 
             std::sort(samples, samples + samplesize);
 
-            classifier.build(samples, samplesize, splitter_lcp);
+            classifier.build(samples, samplesize, splitter_lcp_array);
 
-            // step 2: classify all strings
+            if (StringPtr::in_place)
+            {
+                // steps 2-4: classify and permute blocks in-place
+                BlockDistribution<StringSet> dist(
+                    strset, bktnum, 1,
+                    BlockDistribution<StringSet>::select_block_size(bktnum));
+
+                dist.classify(0, classifier, depth);
+                dist.prepare();
+                dist.permute(0);
+                dist.finish_permute();
+                dist.cleanup(0);
+
+                for (unsigned int i = 0; i <= bktnum; ++i)
+                    bkt_array[i] = dist.bucket_begin(i);
+            }
+            else
+            {
+                // step 2: classify all strings
 
-            classifier.classify(
-                strset, strset.begin(), strset.end(), bktcache, depth);
+                classifier.classify(
+                    strset, strset.begin(), strset.end(), bktcache, depth);
 
-            // step 2.5: count bucket sizes
+                // step 2.5: count bucket sizes
 
-            bktsize_type bktsize[bktnum];
-            memset(bktsize, 0, bktnum * sizeof(bktsize_type));
+                bktsize_type bktsize[bktnum];
+                memset(bktsize, 0, bktnum * sizeof(bktsize_type));
 
-            for (size_t si = 0; si < n; ++si)
-                ++bktsize[bktcache[si]];
+                for (size_t si = 0; si < n; ++si)
+                    ++bktsize[bktcache[si]];
 
-            // step 3: inclusive prefix sum
+                // step 3: inclusive prefix sum
 
-            bkt[0] = bktsize[0];
-            for (unsigned int i = 1; i < bktnum; ++i) {
-                bkt[i] = bkt[i - 1] + bktsize[i];
-            }
-            assert(bkt[bktnum - 1] == n);
-            bkt[bktnum] = n;
+                bkt_array[0] = bktsize[0];
+                for (unsigned int i = 1; i < bktnum; ++i) {
+                    bkt_array[i] = bkt_array[i - 1] + bktsize[i];
+                }
+                assert(bkt_array[bktnum - 1] == n);
+                bkt_array[bktnum] = n;
+
+                // step 4: premute out-of-place
 
-            // step 4: premute out-of-place
+                const StringSet& strB = strptr.active();
+                // get alternative shadow pointer array
+                const StringSet& sorted = strptr.shadow();
+                typename StringSet::Iterator sbegin = sorted.begin();
 
-            const StringSet& strB = strptr.active();
-            // get alternative shadow pointer array
-            const StringSet& sorted = strptr.shadow();
-            typename StringSet::Iterator sbegin = sorted.begin();
+                for (typename StringSet::Iterator str = strB.begin();
+                     str != strB.end(); ++str, ++bktcache)
+                    *(sbegin + --bkt_array[*bktcache]) = std::move(*str);
 
-            for (typename StringSet::Iterator str = strB.begin();
-                 str != strB.end(); ++str, ++bktcache)
-                *(sbegin + --bkt[*bktcache]) = std::move(*str);
+                // bkt is afterwards the exclusive prefix sum of bktsize
+            }
 
-            // bkt is afterwards the exclusive prefix sum of bktsize
 
             // statistics
 
             ++ctx.seq_ss_steps;
         }
 
-        void calculate_lcp()
+        unsigned char splitter_depth(size_t i) const final
+        {
+            return lcpKeyDepth(classifier.get_splitter(i));
+        }
+
+        void calculate_lcp() final
         {
             if (Context::CalcLcp)
-                sample_sort_lcp<bktnum>(classifier, strptr.original(), depth, bkt);
+                sample_sort_lcp<bktnum>(
+                    classifier, strptr.original(), depth, bkt_array);
         }
     };
 
@@ -492,13 +1134,44 @@ public:
     size_t bktcache_size;
 
     size_t ss_pop_front;
-    std::vector<SeqSampleSortStep> ss_stack;
+    std::vector<std::unique_ptr<SeqSampleSortStepBase> > ss_stack;
+
+    //! push a new sequential sample sort step with a splitter tree size
+    //! selected for the subproblem
+    void push_sample_sort_step(Context& ctx, const StringPtr& strptr,
+                               size_t depth)
+    {
+        SeqSampleSortStepBase* s;
+
+        // in-place permutation along cycles is cache efficient only for few
+        // buckets
+        size_t treebits = StringPtr::in_place ? g_treebits_min
+                          : select_treebits(strptr.size(), sizeof(key_type),
+                                            sizeof(bktsize_type));
+        switch (treebits)
+        {
+        case 8:
+            s = new SeqSampleSortStep<8>(ctx, strptr, depth, bktcache);
+            break;
+        case 10:
+            s = new SeqSampleSortStep<10>(ctx, strptr, depth, bktcache);
+            break;
+        case 12:
+            s = new SeqSampleSortStep<12>(ctx, strptr, depth, bktcache);
+            break;
+        default:
+            s = new SeqSampleSortStep<14>(ctx, strptr, depth, bktcache);
+            break;
+        }
+
+        ss_stack.emplace_back(s);
+    }
 
     bool run(Context& ctx) final
     {
         size_t n = in_strptr.size();
 
-        thrid = PS5_ENABLE_RESTSIZE ? omp_get_thread_num() : 0;
+        thrid = PS5_ENABLE_RESTSIZE ? threadpool::thread_num() : 0;
 
         // create anonymous wrapper job
         this->substep_add();
@@ -508,7 +1181,13 @@ public:
         ss_pop_front = 0;
         ms_pop_front = 0;
 
-        if (enable_sequential_sample_sort && n >= g_smallsort_threshold)
+        if (ctx.cancelled())
+        {
+            // leave the strings unsorted in the original array
+            in_strptr.copy_back();
+            ctx.donesize(n, thrid);
+        }
+        else if (enable_sequential_sample_sort && n >= g_smallsort_threshold)
         {
             bktcache = new uint16_t[n];
             bktcache_size = n * sizeof(uint16_t);
@@ -516,7 +1195,7 @@ public:
         }
         else
         {
-            sort_mkqs_cache(ctx, in_strptr, in_depth);
+            sort_mkqs_cache(ctx, in_strptr, in_depth, in_keycache);
         }
 
         delete[] bktcache;
@@ -529,22 +1208,25 @@ public:
 
     void sort_sample_sort(Context& ctx, const StringPtr& strptr, size_t depth)
     {
-        typedef SeqSampleSortStep Step;
+        typedef SeqSampleSortStepBase Step;
 
         assert(ss_pop_front == 0);
         assert(ss_stack.size() == 0);
 
         // sort first level
-        ss_stack.emplace_back(ctx, strptr, depth, bktcache);
+        push_sample_sort_step(ctx, strptr, depth);
 
         // step 5: "recursion"
 
         while (ss_stack.size() > ss_pop_front)
         {
-            Step& s = ss_stack.back();
+            if (ctx.cancel_poll())
+                return sample_sort_cancel(ctx);
+
+            Step& s = *ss_stack.back();
             size_t i = s.idx++; // process the bucket s.idx
 
-            if (i < Step::bktnum)
+            if (i < s.bktnum)
             {
                 size_t bktsize = s.bkt[i + 1] - s.bkt[i];
 
@@ -557,15 +1239,15 @@ public:
                         ;
                     else if (bktsize < g_smallsort_threshold)
                     {
-                        assert(i / 2 <= Step::numsplitters);
+                        assert(i / 2 <= s.bktnum / 2);
 
                         sort_mkqs_cache(
                             ctx, sp, s.depth + (s.splitter_lcp[i / 2] & 0x7F));
                     }
                     else
                     {
-                        ss_stack.emplace_back(
-                            ctx, sp, s.depth + (s.splitter_lcp[i / 2] & 0x7F), bktcache);
+                        push_sample_sort_step(
+                            ctx, sp, s.depth + (s.splitter_lcp[i / 2] & 0x7F));
                     }
                 }
                 // i is odd -> bkt[i] is equal bucket
@@ -578,8 +1260,7 @@ public:
                         StringPtr spb = sp.copy_back();
 
                         if (Context::CalcLcp)
-                            spb.fill_lcp(
-                                s.depth + lcpKeyDepth(s.classifier.get_splitter(i / 2)));
+                            spb.fill_lcp(s.depth + s.splitter_depth(i / 2));
                         ctx.donesize(bktsize, thrid);
                     }
                     else if (bktsize < g_smallsort_threshold)
@@ -588,8 +1269,8 @@ public:
                     }
                     else
                     {
-                        ss_stack.emplace_back(
-                            ctx, sp, s.depth + sizeof(key_type), bktcache);
+                        push_sample_sort_step(
+                            ctx, sp, s.depth + sizeof(key_type));
                     }
                 }
             }
@@ -599,7 +1280,7 @@ public:
                 assert(ss_stack.size() > ss_pop_front);
 
                 // after full sort: calculate LCPs at this level
-                ss_stack.back().calculate_lcp();
+                ss_stack.back()->calculate_lcp();
 
                 ss_stack.pop_back();
             }
@@ -610,6 +1291,26 @@ public:
         }
     }
 
+    //! leave the remaining buckets of the steps on the stack unsorted: copy
+    //! them back to the original array, where the sorted buckets already are.
+    void sample_sort_cancel(Context& ctx)
+    {
+        while (ss_stack.size() > ss_pop_front)
+        {
+            SeqSampleSortStepBase& s = *ss_stack.back();
+
+            // the buckets from s.idx on are untouched in the shadow array, the
+            // bucket before is done, or it is the step above on the stack.
+            size_t begin = s.bkt[std::min(s.idx, s.bktnum)];
+            size_t size = s.strptr.size() - begin;
+
+            s.strptr.flip(begin, size).copy_back();
+            ctx.donesize(size, thrid);
+
+            ss_stack.pop_back();
+        }
+    }
+
     void sample_sort_free_work(Context& ctx)
     {
         assert(ss_stack.size() >= ss_pop_front);
@@ -620,10 +1321,10 @@ public:
         }
 
         // convert top level of stack into independent jobs
-        typedef SeqSampleSortStep Step;
-        Step& s = ss_stack[ss_pop_front];
+        typedef SeqSampleSortStepBase Step;
+        Step& s = *ss_stack[ss_pop_front];
 
-        while (s.idx < Step::bktnum)
+        while (s.idx < s.bktnum)
         {
             size_t i = s.idx++; // process the bucket s.idx
 
@@ -653,7 +1354,7 @@ public:
                     StringPtr spb = sp.copy_back();
 
                     if (Context::CalcLcp)
-                        spb.fill_lcp(s.depth + lcpKeyDepth(s.classifier.get_splitter(i / 2)));
+                        spb.fill_lcp(s.depth + s.splitter_depth(i / 2));
                     ctx.donesize(bktsize, thrid);
                 }
                 else
@@ -801,7 +1502,7 @@ public:
             if (CacheDirty) {
                 typename StringSet::Iterator it = strset.begin();
                 for (size_t i = 0; i < n; ++i, ++it) {
-                    cache[i] = strset.get_uint64(*it, depth);
+                    cache[i] = get_key<key_type>(strset, *it, depth);
                 }
             }
             // select median of 9
@@ -817,7 +1518,7 @@ public:
             key_type pivot = cache[0];
 #if PS5_CALC_LCP_MKQS == 1
             // for immediate LCP calculation
-            key_type max_lt = 0, min_gt = std::numeric_limits<key_type>::max();
+            key_type max_lt = 0, min_gt = ~key_type(0);
 #elif PS5_CALC_LCP_MKQS == 2
             this->pivot = pivot;
 #endif
@@ -939,7 +1640,8 @@ public:
 #elif PS5_CALC_LCP_MKQS == 2
             if (num_lt > 0)
             {
-                key_type max_lt = strptr.original().output().get_uint64(
+                key_type max_lt = get_key<key_type>(
+                    strptr.original().output(),
                     strptr.original().out(num_lt - 1), depth);
 
                 unsigned int rlcp = lcpKeyType(max_lt, pivot);
@@ -949,7 +1651,8 @@ public:
             }
             if (num_gt > 0)
             {
-                key_type min_gt = strptr.original().output().get_uint64(
+                key_type min_gt = get_key<key_type>(
+                    strptr.original().output(),
                     strptr.original().out(num_lt + num_eq), depth);
 
                 unsigned int rlcp = lcpKeyType(pivot, min_gt);
@@ -964,7 +1667,8 @@ public:
     size_t ms_pop_front;
     std::vector<MKQSStep> ms_stack;
 
-    void sort_mkqs_cache(Context& ctx, const StringPtr& strptr, size_t depth)
+    void sort_mkqs_cache(Context& ctx, const StringPtr& strptr, size_t depth,
+                         const KeyCache<key_type>& keycache = KeyCache<key_type>())
     {
         if (!enable_sequential_mkqs ||
             strptr.size() < g_inssort_threshold) {
@@ -974,23 +1678,42 @@ public:
             return;
         }
 
-        if (bktcache_size < strptr.size() * sizeof(key_type)) {
-            delete[] bktcache;
-            bktcache = (uint16_t*)new key_type[strptr.size()];
-            bktcache_size = strptr.size() * sizeof(key_type);
+        key_type* cache;
+        bool cache_dirty = true;
+
+        if (keycache.enabled() && depth >= keycache.depth &&
+            depth < keycache.depth + sizeof(key_type))
+        {
+            // the cached keys still contain the characters at depth: sort
+            // them in place starting at their depth, the strings have a
+            // common prefix up to depth anyway.
+            cache = keycache.active;
+            depth = keycache.depth;
+            cache_dirty = false;
         }
+        else
+        {
+            if (bktcache_size < strptr.size() * sizeof(key_type)) {
+                delete[] bktcache;
+                bktcache = (uint16_t*)new key_type[strptr.size()];
+                bktcache_size = strptr.size() * sizeof(key_type);
+            }
 
-        key_type* cache = (key_type*)bktcache; // reuse bktcache as keycache
+            cache = (key_type*)bktcache; // reuse bktcache as keycache
+        }
 
         assert(ms_pop_front == 0);
         assert(ms_stack.size() == 0);
 
         // std::deque is much slower than std::vector, so we use an artificial
         // pop_front variable.
-        ms_stack.emplace_back(ctx, strptr, cache, depth, true);
+        ms_stack.emplace_back(ctx, strptr, cache, depth, cache_dirty);
 
         while (ms_stack.size() > ms_pop_front)
         {
+            if (ctx.cancel_poll())
+                return mkqs_cancel(ctx);
+
             MKQSStep& ms = ms_stack.back();
             ++ms.idx; // increment here, because stack may change
 
@@ -1076,11 +1799,34 @@ public:
         }
     }
 
-    void mkqs_free_work(Context& ctx)
+    //! leave the remaining parts of the steps on the stack unsorted: copy them
+    //! back to the original array, where the sorted parts already are.
+    void mkqs_cancel(Context& ctx)
     {
-        assert(ms_stack.size() >= ms_pop_front);
-
-        for (unsigned int fl = 0; fl < 8; ++fl)
+        while (ms_stack.size() > ms_pop_front)
+        {
+            MKQSStep& ms = ms_stack.back();
+
+            // the parts after ms.idx are untouched, part ms.idx is done, or it
+            // is the step above on the stack.
+            size_t begin = 0;
+            if (ms.idx >= 1) begin += ms.num_lt;
+            if (ms.idx >= 2) begin += ms.num_eq;
+            if (ms.idx >= 3) begin += ms.num_gt;
+            size_t size = ms.strptr.size() - begin;
+
+            ms.strptr.sub(begin, size).copy_back();
+            ctx.donesize(size, thrid);
+
+            ms_stack.pop_back();
+        }
+    }
+
+    void mkqs_free_work(Context& ctx)
+    {
+        assert(ms_stack.size() >= ms_pop_front);
+
+        for (unsigned int fl = 0; fl < 8; ++fl)
         {
             if (ms_stack.size() == ms_pop_front) {
                 return;
@@ -1137,7 +1883,7 @@ public:
         }
 
         while (ss_pop_front > 0) {
-            ss_stack[--ss_pop_front].calculate_lcp();
+            ss_stack[--ss_pop_front]->calculate_lcp();
         }
 
         if (pstep) pstep->substep_notify_done();
@@ -1148,16 +1894,21 @@ public:
 // ****************************************************************************
 // *** SampleSortStep out-of-place parallel sample sort with separate Jobs
 
-template <typename Context, template <size_t> class Classify, typename StringPtr>
+template <typename Context, template <size_t> class Classify,
+          typename StringPtr, size_t TreeBits>
 class SampleSortStep : public SortStep
 {
 public:
     typedef typename StringPtr::StringSet StringSet;
     typedef typename StringSet::Iterator StrIterator;
+    typedef typename StringSet::String String;
 
     //! type of Job
     typedef typename Context::job_type job_type;
 
+    //! key type of the classifier
+    typedef typename Classify<TreeBits>::key_type key_type;
+
     //! parent sort step notification
     SortStep* pstep;
 
@@ -1165,6 +1916,9 @@ public:
     StringPtr strptr;
     size_t depth;
 
+    //! keys of the strings, permuted alongside strptr (if enabled)
+    KeyCache<key_type> keycache;
+
     //! number of parts into which the strings were split
     size_t parts;
     //! size of all parts except the last
@@ -1173,12 +1927,10 @@ public:
     std::atomic<size_t> pwork;
 
     //! classifier instance and variables (contains splitter tree
-    Classify<bingmann_sample_sort::DefaultTreebits> classifier;
+    Classify<TreeBits> classifier;
 
-    static const size_t treebits =
-        Classify<bingmann_sample_sort::DefaultTreebits>::treebits;
-    static const size_t numsplitters =
-        Classify<bingmann_sample_sort::DefaultTreebits>::numsplitters;
+    static const size_t treebits = Classify<TreeBits>::treebits;
+    static const size_t numsplitters = Classify<TreeBits>::numsplitters;
     static const size_t bktnum = 2 * numsplitters + 1;
 
     //! LCPs of splitters, needed for recursive calls
@@ -1189,6 +1941,9 @@ public:
     //! bucket ids cache, created by classifier and later counted
     uint16_t* bktcache[MAXPROCS];
 
+    //! in-place distribution, replacing count and distribute steps
+    std::unique_ptr<BlockDistribution<StringSet> > blockdist;
+
     // *** Classes for JobQueue
 
     struct SampleJob : public job_type
@@ -1200,9 +1955,19 @@ public:
 
         bool run(Context& ctx) final
         {
-            step->sample(ctx);
+            if (ctx.cancelled())
+                step->cancel(ctx);
+            else
+                step->sample(ctx);
             return true;
         }
+
+        //! the jobs of a step delay all its buckets, hence they get the
+        //! priority of the whole step.
+        size_t priority() const final
+        {
+            return step->strptr.size();
+        }
     };
 
     struct CountJob : public job_type
@@ -1218,6 +1983,11 @@ public:
             step->count(p, ctx);
             return true;
         }
+
+        size_t priority() const final
+        {
+            return step->strptr.size();
+        }
     };
 
     struct DistributeJob : public job_type
@@ -1233,13 +2003,59 @@ public:
             step->distribute(p, ctx);
             return true;
         }
+
+        size_t priority() const final
+        {
+            return step->strptr.size();
+        }
+    };
+
+    struct PermuteJob : public job_type
+    {
+        SampleSortStep* step;
+        unsigned int  p;
+
+        PermuteJob(SampleSortStep* _step, unsigned int _p)
+            : step(_step), p(_p) { }
+
+        bool run(Context& ctx) final
+        {
+            step->permute(p, ctx);
+            return true;
+        }
+
+        size_t priority() const final
+        {
+            return step->strptr.size();
+        }
+    };
+
+    struct CleanupJob : public job_type
+    {
+        SampleSortStep* step;
+        unsigned int  p;
+
+        CleanupJob(SampleSortStep* _step, unsigned int _p)
+            : step(_step), p(_p) { }
+
+        bool run(Context& ctx) final
+        {
+            step->cleanup(p, ctx);
+            return true;
+        }
+
+        size_t priority() const final
+        {
+            return step->strptr.size();
+        }
     };
 
     // *** Constructor
 
     SampleSortStep(Context& ctx, SortStep* pstep,
-                   const StringPtr& strptr, size_t depth)
-        : pstep(pstep), strptr(strptr), depth(depth)
+                   const StringPtr& strptr, size_t depth,
+                   const KeyCache<key_type>& keycache)
+        : pstep(pstep), strptr(strptr), depth(depth), keycache(keycache)
     {
         parts = strptr.size() / ctx.sequential_threshold() * 2;
         if (parts == 0) parts = 1;
@@ -1247,7 +2063,16 @@ public:
 
         psize = (strptr.size() + parts - 1) / parts;
 
-        ctx.jobqueue.enqueue(new SampleJob(this));
+        if (StringPtr::in_place)
+        {
+            blockdist.reset(new BlockDistribution<StringSet>(
+                                strptr.active(), bktnum, parts,
+                                BlockDistribution<StringSet>::select_block_size(
+                                    bktnum)));
+            parts = blockdist->parts();
+        }
+
+        ctx.jobqueue.enqueue(new (ctx.objpool) SampleJob(this));
         ++ctx.para_ss_steps;
     }
 
@@ -1269,7 +2094,11 @@ public:
         LCGRandom rng(&samples);
 
         for (size_t i = 0; i < samplesize; ++i)
-            samples[i] = strset.get_uint64(strset[begin + rng() % n], depth);
+        {
+            size_t j = rng() % n;
+            if (!keycache.get(j, depth, samples[i]))
+                samples[i] = get_key<key_type>(strset, strset[begin + j], depth);
+        }
 
         std::sort(samples, samples + samplesize);
 
@@ -1278,13 +2107,26 @@ public:
         // create new jobs
         pwork = parts;
         for (unsigned int p = 0; p < parts; ++p)
-            ctx.jobqueue.enqueue(new CountJob(this, p));
+            ctx.jobqueue.enqueue(new (ctx.objpool) CountJob(this, p));
     }
 
     // *** Counting Step
 
     void count(unsigned int p, Context& ctx)
     {
+        if (StringPtr::in_place)
+            return classify_blocks(p, ctx);
+
+        if (ctx.cancelled()) {
+            // skip classification, count_finished() cancels the step
+            bktcache[p] = NULL;
+            bkt[p] = NULL;
+
+            if (--pwork == 0)
+                count_finished(ctx);
+            return;
+        }
+
         const StringSet& strset = strptr.active();
 
         StrIterator strB = strset.begin() + p * psize;
@@ -1292,7 +2134,30 @@ public:
         if (strE < strB) strE = strB;
 
         uint16_t* mybktcache = bktcache[p] = new uint16_t[strE - strB];
-        classifier.classify(strset, strB, strE, mybktcache, depth);
+
+        if (keycache.enabled())
+        {
+            // refresh the key cache at this depth, then classify the keys
+            size_t offset = strB - strset.begin();
+            key_type* keys = keycache.active + offset;
+
+            for (StrIterator str = strB; str != strE; ++str, ++keys)
+            {
+                if (!keycache.get(str - strset.begin(), depth, *keys)) {
+                    bingmann_sample_sort::prefetch_keys(strset, str, strE, depth);
+                    *keys = get_key<key_type>(strset, *str, depth);
+                }
+            }
+
+            KeyCacheSet<key_type> keyset(
+                keycache.active + offset, keycache.active + offset + (strE - strB));
+            classifier.classify(
+                keyset, keyset.begin(), keyset.end(), mybktcache, depth);
+        }
+        else
+        {
+            classifier.classify(strset, strB, strE, mybktcache, depth);
+        }
 
         size_t* mybkt = bkt[p] = new size_t[bktnum + (p == 0 ? 1 : 0)];
         memset(mybkt, 0, bktnum * sizeof(size_t));
@@ -1310,6 +2175,15 @@ public:
         if (use_only_first_sortstep)
             return;
 
+        // the strings are still untouched before the distribution
+        if (ctx.cancelled()) {
+            for (unsigned int p = 0; p < parts; ++p) {
+                delete[] bktcache[p];
+                delete[] bkt[p];
+            }
+            return cancel(ctx);
+        }
+
         // inclusive prefix sum over bkt
         size_t sum = 0;
         for (unsigned int i = 0; i < bktnum; ++i)
@@ -1324,7 +2198,69 @@ public:
         // create new jobs
         pwork = parts;
         for (unsigned int p = 0; p < parts; ++p)
-            ctx.jobqueue.enqueue(new DistributeJob(this, p));
+            ctx.jobqueue.enqueue(new (ctx.objpool) DistributeJob(this, p));
+    }
+
+    // *** In-Place Distribution
+
+    void classify_blocks(unsigned int p, Context& ctx)
+    {
+        // skip classification if cancelled, the strings stay untouched
+        if (!ctx.cancelled())
+            blockdist->classify(p, classifier, depth);
+
+        if (--pwork == 0)
+            classify_blocks_finished(ctx);
+    }
+
+    void classify_blocks_finished(Context& ctx)
+    {
+        // abort sorting if we're measuring only the top level
+        if (use_only_first_sortstep)
+            return;
+
+        if (ctx.cancelled()) {
+            // return the buffered strings to their part
+            for (unsigned int p = 0; p < parts; ++p)
+                blockdist->restore(p);
+            return cancel(ctx);
+        }
+
+        blockdist->prepare();
+
+        // create new jobs
+        pwork = parts;
+        for (unsigned int p = 0; p < parts; ++p)
+            ctx.jobqueue.enqueue(new (ctx.objpool) PermuteJob(this, p));
+    }
+
+    void permute(unsigned int p, Context& ctx)
+    {
+        blockdist->permute(p);
+
+        if (--pwork == 0) {
+            blockdist->finish_permute();
+
+            // create new jobs
+            pwork = parts;
+            for (unsigned int q = 0; q < parts; ++q)
+                ctx.jobqueue.enqueue(new (ctx.objpool) CleanupJob(this, q));
+        }
+    }
+
+    void cleanup(unsigned int p, Context& ctx)
+    {
+        blockdist->cleanup(p);
+
+        if (--pwork == 0) {
+            // the bucket boundaries, as left by the out-of-place distribution
+            bkt[0] = new size_t[bktnum + 1];
+            for (unsigned int i = 0; i < bktnum; ++i)
+                bkt[0][i] = blockdist->bucket_begin(i);
+
+            blockdist.reset();
+            distribute_finished(ctx);
+        }
     }
 
     // *** Distribute Step
@@ -1343,8 +2279,23 @@ public:
         uint16_t* mybktcache = bktcache[p];
         size_t* mybkt = bkt[p];
 
-        for (StrIterator str = strB; str != strE; ++str, ++mybktcache)
-            *(sbegin + --mybkt[*mybktcache]) = std::move(*str);
+        if (keycache.enabled())
+        {
+            // move keys alongside the strings
+            const key_type* keys = keycache.active + (strB - strset.begin());
+
+            for (StrIterator str = strB; str != strE; ++str, ++mybktcache)
+            {
+                size_t j = --mybkt[*mybktcache];
+                *(sbegin + j) = std::move(*str);
+                keycache.shadow[j] = *keys++;
+            }
+        }
+        else
+        {
+            for (StrIterator str = strB; str != strE; ++str, ++mybktcache)
+                *(sbegin + --mybkt[*mybktcache]) = std::move(*str);
+        }
 
         if (p != 0) // p = 0 is needed for recursion into bkts
             delete[] bkt[p];
@@ -1357,7 +2308,7 @@ public:
 
     void distribute_finished(Context& ctx)
     {
-        size_t thrid = PS5_ENABLE_RESTSIZE ? omp_get_thread_num() : 0;
+        size_t thrid = PS5_ENABLE_RESTSIZE ? threadpool::thread_num() : 0;
 
         size_t* bkt = this->bkt[0];
         assert(bkt);
@@ -1384,7 +2335,8 @@ public:
             {
                 this->substep_add();
                 Enqueue<Classify>(ctx, this, strptr.flip(bkt[i], bktsize),
-                                  depth + (splitter_lcp[i / 2] & 0x7F));
+                                  depth + (splitter_lcp[i / 2] & 0x7F),
+                                  keycache.flip(bkt[i], depth));
             }
             ++i;
             // i is odd -> bkt[i] is equal bucket
@@ -1406,7 +2358,8 @@ public:
                 else {
                     this->substep_add();
                     Enqueue<Classify>(ctx, this, strptr.flip(bkt[i], bktsize),
-                                      depth + sizeof(key_type));
+                                      depth + sizeof(key_type),
+                                      keycache.flip(bkt[i], depth));
                 }
             }
             ++i;
@@ -1423,7 +2376,8 @@ public:
         else
         {
             this->substep_add();
-            Enqueue<Classify>(ctx, this, strptr.flip(bkt[i], bktsize), depth);
+            Enqueue<Classify>(ctx, this, strptr.flip(bkt[i], bktsize), depth,
+                              keycache.flip(bkt[i], depth));
         }
 
         this->substep_notify_done(); // release anonymous subjob handle
@@ -1433,6 +2387,17 @@ public:
         }
     }
 
+    //! leave the strings unsorted in the original array, called instead of
+    //! sample() or distribute() if the sort was cancelled.
+    void cancel(Context& ctx)
+    {
+        strptr.copy_back();
+        ctx.donesize(strptr.size(), threadpool::thread_num());
+
+        if (pstep) pstep->substep_notify_done();
+        delete this;
+    }
+
     // *** After Recursive Sorting
 
     void substep_all_done() final
@@ -1451,21 +2416,68 @@ template <template <size_t> class Classify, typename Context, typename StringPtr
 void Enqueue(Context& ctx, SortStep* pstep,
              const StringPtr& strptr, size_t depth)
 {
+    typedef typename Classify<bingmann_sample_sort::DefaultTreebits>::key_type
+        key_type;
+
+    Enqueue<Classify>(ctx, pstep, strptr, depth, KeyCache<key_type>());
+}
+
+//! Enqueue a sort step for strptr, which continues with the keycache.
+template <template <size_t> class Classify, typename Context, typename StringPtr,
+          typename KeyType>
+void Enqueue(Context& ctx, SortStep* pstep,
+             const StringPtr& strptr, size_t depth,
+             const KeyCache<KeyType>& keycache)
+{
+    typedef KeyType key_type;
+
+    if (ctx.cancelled()) {
+        // leave the strings unsorted in the original array. The caller
+        // registered a substep at pstep, which is done now.
+        strptr.copy_back();
+        ctx.donesize(strptr.size(), threadpool::thread_num());
+        if (pstep) pstep->substep_notify_done();
+        return;
+    }
+
     if (enable_parallel_sample_sort &&
         (strptr.size() > ctx.sequential_threshold() || use_only_first_sortstep)) {
-        new SampleSortStep<Context, Classify, StringPtr>(
-            ctx, pstep, strptr, depth);
+        // the in-place distribution keeps a block buffer per bucket and part
+        size_t treebits = StringPtr::in_place ? g_treebits_min
+                          : select_treebits(strptr.size(), sizeof(key_type),
+                                            sizeof(size_t));
+        switch (treebits)
+        {
+        case 8:
+            new (ctx.objpool) SampleSortStep<Context, Classify, StringPtr, 8>(
+                ctx, pstep, strptr, depth, keycache);
+            break;
+        case 10:
+            new (ctx.objpool) SampleSortStep<Context, Classify, StringPtr, 10>(
+                ctx, pstep, strptr, depth, keycache);
+            break;
+        case 12:
+            new (ctx.objpool) SampleSortStep<Context, Classify, StringPtr, 12>(
+                ctx, pstep, strptr, depth, keycache);
+            break;
+        default:
+            new (ctx.objpool) SampleSortStep<Context, Classify, StringPtr, 14>(
+                ctx, pstep, strptr, depth, keycache);
+            break;
+        }
     }
     else {
         if (strptr.size() < ((uint64_t)1 << 32)) {
             ctx.jobqueue.enqueue(
-                new SmallsortJob<Context, Classify, StringPtr, uint32_t>(
-                    pstep, strptr, depth));
+                new (ctx.objpool)
+                SmallsortJob<Context, Classify, StringPtr, uint32_t>(
+                    pstep, strptr, depth, keycache));
         }
         else {
             ctx.jobqueue.enqueue(
-                new SmallsortJob<Context, Classify, StringPtr, uint64_t>(
-                    pstep, strptr, depth));
+                new (ctx.objpool)
+                SmallsortJob<Context, Classify, StringPtr, uint64_t>(
+                    pstep, strptr, depth, keycache));
         }
     }
 }
@@ -1473,32 +2485,138 @@ void Enqueue(Context& ctx, SortStep* pstep,
 /******************************************************************************/
 // Externally Callable Sorting Methods
 
-//! Main Parallel Sample Sort Function. See below for more convenient wrappers.
-template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
-          typename StringPtr>
-void parallel_sample_sort(const StringPtr& strptr, size_t depth)
+//! Enqueue the first sort step of strptr into the Context ctx, whose threadnum
+//! is already set. Returns the key cache array, which must be freed with
+//! parallel_sample_sort_finish() after the job queue has finished, or NULL.
+template <template <size_t> class Classify, typename Context, typename StringPtr>
+typename Classify<bingmann_sample_sort::DefaultTreebits>::key_type*
+parallel_sample_sort_start(Context& ctx, const StringPtr& strptr, size_t depth)
 {
-    using SContext = Context<StringPtr::with_lcp>;
-    SContext ctx;
+    typedef typename Classify<bingmann_sample_sort::DefaultTreebits>::key_type
+        key_type;
+
     ctx.totalsize = strptr.size();
 #if PS5_ENABLE_RESTSIZE
     ctx.restsize = strptr.size();
 #endif
-    ctx.threadnum = omp_get_max_threads();
+    ctx.aborted = false;
+
+    // the key cache would need twice the memory saved by sorting in-place
+    if (g_ps5_keycache && !StringPtr::in_place)
+    {
+        // allocate key cache and its shadow array
+        key_type* keys = new key_type[2 * strptr.size()];
+        Enqueue<Classify>(ctx, NULL, strptr, depth,
+                          KeyCache<key_type>(keys, keys + strptr.size(),
+                                             size_t(-1)));
+        return keys;
+    }
+    else
+    {
+        Enqueue<Classify>(ctx, NULL, strptr, depth);
+        return NULL;
+    }
+}
 
-    Enqueue<Classify>(ctx, NULL, strptr, depth);
-    ctx.jobqueue.loop();
+//! Free the key cache array returned by parallel_sample_sort_start().
+template <typename Context, typename KeyType>
+void parallel_sample_sort_finish(Context& ctx, KeyType* keys)
+{
+    delete[] keys;
 
 #if PS5_ENABLE_RESTSIZE
     assert(!PS5_ENABLE_RESTSIZE || ctx.restsize.update().get() == 0);
+#else
+    (void)ctx;
+#endif
+}
+
+//! Run Parallel Sample Sort on strptr with the Context ctx, whose threadnum
+//! and executor are already set. The Context may be reused for further calls.
+template <template <size_t> class Classify, typename Context, typename StringPtr>
+void parallel_sample_sort_context(Context& ctx, const StringPtr& strptr,
+                                  size_t depth)
+{
+    auto keys = parallel_sample_sort_start<Classify>(ctx, strptr, depth);
+    ctx.loop();
+    parallel_sample_sort_finish(ctx, keys);
+}
+
+//! Run Parallel Sample Sort on the segments [offsets[i],offsets[i+1]) of
+//! strptr for i < nsegments independently, in one job queue loop of the
+//! Context ctx. Segments larger than the sequential threshold get a parallel
+//! SampleSortStep and are enqueued first, all others a SmallsortJob in the
+//! order of the segments, which keeps consecutive jobs close in memory.
+template <template <size_t> class Classify, typename Context, typename StringPtr>
+void parallel_sample_sort_segments_context(
+    Context& ctx, const StringPtr& strptr,
+    const size_t* offsets, size_t nsegments, size_t depth)
+{
+    typedef typename Classify<bingmann_sample_sort::DefaultTreebits>::key_type
+        key_type;
+
+    ctx.totalsize = strptr.size();
+#if PS5_ENABLE_RESTSIZE
+    ctx.restsize = strptr.size();
 #endif
+    ctx.aborted = false;
+
+    // one key cache array and its shadow for all segments
+    key_type* keys = g_ps5_keycache && !StringPtr::in_place
+                     ? new key_type[2 * strptr.size()] : NULL;
+
+    size_t threshold = ctx.sequential_threshold();
+
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        for (size_t i = 0; i < nsegments; ++i)
+        {
+            assert(offsets[i] <= offsets[i + 1]);
+            assert(offsets[i + 1] <= strptr.size());
+
+            size_t begin = offsets[i], size = offsets[i + 1] - begin;
+
+            // empty segments have nothing to sort
+            if (size == 0 || (size > threshold) != (pass == 0)) continue;
+
+            if (keys)
+                Enqueue<Classify>(ctx, NULL, strptr.sub(begin, size), depth,
+                                  KeyCache<key_type>(
+                                      keys + begin, keys + strptr.size() + begin,
+                                      size_t(-1)));
+            else
+                Enqueue<Classify>(ctx, NULL, strptr.sub(begin, size), depth);
+        }
+    }
+
+    ctx.loop();
+    parallel_sample_sort_finish(ctx, keys);
+}
+
+//! Main Parallel Sample Sort Function. See below for more convenient wrappers.
+//! JobQueueGroupType selects the job queue, e.g. WorkStealingJobQueueGroup.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringPtr>
+void parallel_sample_sort(const StringPtr& strptr, size_t depth)
+{
+    // select instruction set of classifier kernels on the first call, see
+    // cpu_features::selected_isa_name() for the result.
+    cpu_features::select_isa();
+
+    using SContext = Context<StringPtr::with_lcp, JobQueueGroupType>;
+    SContext ctx;
+    ctx.threadnum = omp_get_max_threads();
+
+    parallel_sample_sort_context<Classify>(ctx, strptr, depth);
 }
 
 //! call Sample Sort on a generic StringSet, this allocates the shadow array for
 //! flipping.
 template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
           typename StringSet>
 void parallel_sample_sort_base(const StringSet& strset, size_t depth)
 {
@@ -1509,7 +2627,152 @@ void parallel_sample_sort_base(const StringSet& strset, size_t depth)
     Container shadow = strset.allocate(strset.size());
     StringShadowPtr strptr(strset, StringSet(shadow));
 
-    parallel_sample_sort<Classify>(strptr, depth);
+    parallel_sample_sort<Classify, JobQueueGroupType>(strptr, depth);
+
+    StringSet::deallocate(shadow);
+}
+
+//! call Sample Sort in-place on a generic StringSet, without a shadow array:
+//! parallel steps permute blocks of strings within the array.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
+void parallel_sample_sort_inplace_base(const StringSet& strset, size_t depth)
+{
+    typedef stringtools::StringInPlacePtr<StringSet> StringInPlacePtr;
+
+    parallel_sample_sort<Classify, JobQueueGroupType>(
+        StringInPlacePtr(strset), depth);
+}
+
+//! Parallel Sample Sort which stops early if cancel is cancelled or its
+//! deadline passes. Returns false if the sort was cancelled, then strptr holds
+//! all strings in unspecified order and the LCPs are undefined.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringPtr>
+bool parallel_sample_sort(const StringPtr& strptr, size_t depth,
+                          CancelToken& cancel)
+{
+    cpu_features::select_isa();
+
+    using SContext = Context<StringPtr::with_lcp, JobQueueGroupType>;
+    SContext ctx;
+    ctx.threadnum = omp_get_max_threads();
+    ctx.cancel = &cancel;
+
+    parallel_sample_sort_context<Classify>(ctx, strptr, depth);
+    return !ctx.aborted;
+}
+
+//! call cancellable Sample Sort on a generic StringSet, this allocates the
+//! shadow array for flipping. Returns false if the sort was cancelled.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
+bool parallel_sample_sort_base(const StringSet& strset, size_t depth,
+                               CancelToken& cancel)
+{
+    typedef stringtools::StringShadowPtr<StringSet> StringShadowPtr;
+    typedef typename StringSet::Container Container;
+
+    // allocate shadow pointer array
+    Container shadow = strset.allocate(strset.size());
+    StringShadowPtr strptr(strset, StringSet(shadow));
+
+    bool done = parallel_sample_sort<Classify, JobQueueGroupType>(
+        strptr, depth, cancel);
+
+    StringSet::deallocate(shadow);
+    return done;
+}
+
+//! Parallel Sample Sort on the threads of executor, e.g. an application's
+//! thread pool, with at most nthreads threads (0 = executor.size()).
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringPtr>
+void parallel_sample_sort(const StringPtr& strptr, size_t depth,
+                          threadpool::Executor& executor, size_t nthreads = 0)
+{
+    cpu_features::select_isa();
+
+    using SContext = Context<StringPtr::with_lcp, JobQueueGroupType>;
+    SContext ctx;
+    ctx.executor = &executor;
+    ctx.threadnum = (nthreads == 0) ? executor.size()
+                    : std::min(nthreads, executor.size());
+
+    parallel_sample_sort_context<Classify>(ctx, strptr, depth);
+}
+
+//! call Sample Sort on a generic StringSet on the threads of executor, this
+//! allocates the shadow array for flipping.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
+void parallel_sample_sort_base(const StringSet& strset, size_t depth,
+                               threadpool::Executor& executor,
+                               size_t nthreads = 0)
+{
+    typedef stringtools::StringShadowPtr<StringSet> StringShadowPtr;
+    typedef typename StringSet::Container Container;
+
+    // allocate shadow pointer array
+    Container shadow = strset.allocate(strset.size());
+    StringShadowPtr strptr(strset, StringSet(shadow));
+
+    parallel_sample_sort<Classify, JobQueueGroupType>(
+        strptr, depth, executor, nthreads);
+
+    StringSet::deallocate(shadow);
+}
+
+//! Batched Segmented Parallel Sample Sort: sort the segments
+//! [offsets[i],offsets[i+1]) of strptr for i < nsegments independently, with
+//! one Context and job queue loop for all.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringPtr>
+void parallel_sample_sort_segments(
+    const StringPtr& strptr, const size_t* offsets, size_t nsegments,
+    size_t depth)
+{
+    cpu_features::select_isa();
+
+    using SContext = Context<StringPtr::with_lcp, JobQueueGroupType>;
+    SContext ctx;
+    ctx.threadnum = omp_get_max_threads();
+
+    parallel_sample_sort_segments_context<Classify>(
+        ctx, strptr, offsets, nsegments, depth);
+}
+
+//! call Batched Segmented Sample Sort on a generic StringSet, this allocates
+//! one shadow array shared by all segments.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
+void parallel_sample_sort_segments_base(
+    const StringSet& strset, const size_t* offsets, size_t nsegments,
+    size_t depth)
+{
+    typedef stringtools::StringShadowPtr<StringSet> StringShadowPtr;
+    typedef typename StringSet::Container Container;
+
+    // allocate shadow pointer array
+    Container shadow = strset.allocate(strset.size());
+    StringShadowPtr strptr(strset, StringSet(shadow));
+
+    parallel_sample_sort_segments<Classify, JobQueueGroupType>(
+        strptr, offsets, nsegments, depth);
 
     StringSet::deallocate(shadow);
 }
@@ -1517,7 +2780,7 @@ void parallel_sample_sort_base(const StringSet& strset, size_t depth)
 //! call Sample Sort on a generic input StringSet, but write output to output
 //! StringSet, use output as shadow array for flipping.
 template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
+              bingmann_sample_sort::ClassifyRadixLookupX,
           typename StringSet>
 void parallel_sample_sort_out_base(
     const StringSet& strset, const StringSet& output, size_t depth)
@@ -1529,7 +2792,7 @@ void parallel_sample_sort_out_base(
 }
 
 template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
+              bingmann_sample_sort::ClassifyRadixLookupX,
           typename StringSet>
 void parallel_sample_sort_out_test(const StringSet& strset, size_t depth)
 {
@@ -1545,7 +2808,9 @@ void parallel_sample_sort_out_test(const StringSet& strset, size_t depth)
 
 /******************************************************************************/
 
-template <template <size_t> class Classify, typename StringSet>
+template <template <size_t> class Classify,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
 void parallel_sample_sort_lcp_base(
     const StringSet& strset, uintptr_t* lcp, size_t depth)
 {
@@ -1557,13 +2822,13 @@ void parallel_sample_sort_lcp_base(
 
     StringShadowLcpPtr strptr(strset, StringSet(shadow), lcp);
 
-    parallel_sample_sort<Classify>(strptr, depth);
+    parallel_sample_sort<Classify, JobQueueGroupType>(strptr, depth);
 
     StringSet::deallocate(shadow);
 }
 
 template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
+              bingmann_sample_sort::ClassifyRadixLookupX,
           typename StringSet>
 void parallel_sample_sort_lcp_base(const StringSet& strset, size_t depth)
 {
@@ -1572,19 +2837,51 @@ void parallel_sample_sort_lcp_base(const StringSet& strset, size_t depth)
 }
 
 template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
           typename StringSet>
 void parallel_sample_sort_lcp_verify(const StringSet& strset, size_t depth)
 {
     std::vector<uintptr_t> tmp_lcp(strset.size());
     tmp_lcp[0] = 42;                 // must keep lcp[0] unchanged
     std::fill(tmp_lcp.begin() + 1, tmp_lcp.end(), -1);
-    parallel_sample_sort_lcp_base<Classify>(strset, tmp_lcp.data(), depth);
+    parallel_sample_sort_lcp_base<Classify, JobQueueGroupType>(
+        strset, tmp_lcp.data(), depth);
+    die_unless(stringtools::verify_lcp(strset, tmp_lcp.data(), 42));
+}
+
+//! call Sample Sort in-place on a generic StringSet, without a shadow array,
+//! and save the LCPs.
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
+void parallel_sample_sort_inplace_lcp_base(
+    const StringSet& strset, uintptr_t* lcp, size_t depth)
+{
+    typedef stringtools::StringInPlaceLcpPtr<StringSet> StringInPlaceLcpPtr;
+
+    parallel_sample_sort<Classify, JobQueueGroupType>(
+        StringInPlaceLcpPtr(strset, lcp), depth);
+}
+
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup,
+          typename StringSet>
+void parallel_sample_sort_inplace_lcp_verify(
+    const StringSet& strset, size_t depth)
+{
+    std::vector<uintptr_t> tmp_lcp(strset.size());
+    tmp_lcp[0] = 42;                 // must keep lcp[0] unchanged
+    std::fill(tmp_lcp.begin() + 1, tmp_lcp.end(), -1);
+    parallel_sample_sort_inplace_lcp_base<Classify, JobQueueGroupType>(
+        strset, tmp_lcp.data(), depth);
     die_unless(stringtools::verify_lcp(strset, tmp_lcp.data(), 42));
 }
 
 template <template <size_t> class Classify =
-              bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX,
+              bingmann_sample_sort::ClassifyRadixLookupX,
           typename StringSet>
 void parallel_sample_sort_out_lcp_verify(const StringSet& strset, size_t depth)
 {
@@ -1609,6 +2906,248 @@ void parallel_sample_sort_out_lcp_verify(const StringSet& strset, size_t depth)
     StringSet::deallocate(out);
 }
 
+/******************************************************************************/
+
+/*!
+ * Persistent Parallel Sample Sort for many consecutive sorts, e.g. of small
+ * batches. It keeps a resident ThreadPool whose threads are parked between
+ * calls, and the Contexts with their job queues, instead of starting an OpenMP
+ * parallel region and constructing a Context for each sort.
+ *
+ * Inputs of fewer than min_strings_per_thread strings per thread are sorted
+ * with fewer threads, small ones entirely on the calling thread. A Sorter
+ * sorts one input at a time; use one Sorter per calling thread.
+ */
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX,
+          template <typename> class JobQueueGroupType = DefaultJobQueueGroup>
+class Sorter
+{
+public:
+    //! minimum number of strings per thread woken for a sort
+    static const size_t min_strings_per_thread = 64 * 1024;
+
+    //! start a Sorter with num_threads threads including the caller.
+    explicit Sorter(size_t num_threads = omp_get_max_threads())
+        : m_pool(num_threads)
+    {
+        cpu_features::select_isa();
+
+        m_ctx.executor = &m_pool;
+        m_ctx_lcp.executor = &m_pool;
+    }
+
+    //! number of threads including the caller
+    size_t num_threads() const
+    {
+        return m_pool.size();
+    }
+
+    //! number of job and step objects allocated by all sorts so far
+    size_t objects_allocated() const
+    {
+        return m_ctx.objects_allocated() + m_ctx_lcp.objects_allocated();
+    }
+
+    //! number of those which were not recycled but needed a malloc()
+    size_t objects_malloced() const
+    {
+        return m_ctx.objects_malloced() + m_ctx_lcp.objects_malloced();
+    }
+
+    //! sort strptr, the analog of parallel_sample_sort().
+    template <typename StringPtr>
+    void sort(const StringPtr& strptr, size_t depth = 0)
+    {
+        auto& ctx = context(std::integral_constant<bool, StringPtr::with_lcp>());
+
+        size_t nthreads = strptr.size() / min_strings_per_thread;
+        ctx.threadnum = std::max<size_t>(
+            1, std::min(nthreads, m_pool.size()));
+
+        parallel_sample_sort_context<Classify>(ctx, strptr, depth);
+    }
+
+    //! sort a generic StringSet, allocating the shadow array.
+    template <typename StringSet>
+    void sort_base(const StringSet& strset, size_t depth = 0)
+    {
+        typedef stringtools::StringShadowPtr<StringSet> StringShadowPtr;
+        typedef typename StringSet::Container Container;
+
+        Container shadow = strset.allocate(strset.size());
+        sort(StringShadowPtr(strset, StringSet(shadow)), depth);
+        StringSet::deallocate(shadow);
+    }
+
+    //! sort a generic StringSet and calculate its LCP array.
+    template <typename StringSet>
+    void sort_lcp(const StringSet& strset, uintptr_t* lcp, size_t depth = 0)
+    {
+        typedef stringtools::StringShadowLcpPtr<StringSet> StringShadowLcpPtr;
+        typedef typename StringSet::Container Container;
+
+        Container shadow = strset.allocate(strset.size());
+        sort(StringShadowLcpPtr(strset, StringSet(shadow), lcp), depth);
+        StringSet::deallocate(shadow);
+    }
+
+    //! sort an array of n strings, reusing the shadow array of earlier calls.
+    void sort(string* strings, size_t n, size_t depth = 0)
+    {
+        typedef stringtools::StringShadowPtr<UCharStringSet> StringShadowPtr;
+
+        if (m_shadow.size() < n) m_shadow.resize(n);
+
+        sort(StringShadowPtr(
+                 UCharStringSet(strings, strings + n),
+                 UCharStringSet(m_shadow.data(), m_shadow.data() + n)),
+             depth);
+    }
+
+protected:
+    //! threads processing the job queues, parked between sorts
+    threadpool::ThreadPool m_pool;
+
+    //! Contexts reused for sorts without and with LCP calculation
+    Context<false, JobQueueGroupType> m_ctx;
+    Context<true, JobQueueGroupType> m_ctx_lcp;
+
+    //! shadow array of sort(strings, n)
+    std::vector<string> m_shadow;
+
+    Context<false, JobQueueGroupType>& context(std::false_type)
+    {
+        return m_ctx;
+    }
+
+    Context<true, JobQueueGroupType>& context(std::true_type)
+    {
+        return m_ctx_lcp;
+    }
+};
+
+/*!
+ * Asynchronous Parallel Sample Sort: sort() enqueues the first sort step and
+ * returns immediately, the sort is run by a JobQueuePool shared by all sorts
+ * of the AsyncSorter. Hence several sorts may be in flight, each with its own
+ * Context and job queue, and the pool threads take turns running jobs of
+ * each. The input must stay valid until the sort is done, which is signaled
+ * by a callback or a std::future.
+ *
+ * The destructor waits for all sorts in flight.
+ */
+template <template <size_t> class Classify =
+              bingmann_sample_sort::ClassifyRadixLookupX>
+class AsyncSorter
+{
+public:
+    //! start an AsyncSorter with num_threads pool threads
+    explicit AsyncSorter(size_t num_threads = omp_get_max_threads())
+        : m_pool(num_threads)
+    {
+        cpu_features::select_isa();
+    }
+
+    //! number of pool threads
+    size_t num_threads() const
+    {
+        return m_pool.size();
+    }
+
+    //! sort strptr and call done on a pool thread when finished.
+    template <typename StringPtr>
+    void sort(const StringPtr& strptr, size_t depth,
+              const std::function<void()>& done)
+    {
+        new Sort<StringPtr>(m_pool, strptr, depth, done);
+    }
+
+    //! sort strptr, the returned future becomes ready when finished.
+    template <typename StringPtr>
+    std::future<void> sort(const StringPtr& strptr, size_t depth = 0)
+    {
+        auto promise = std::make_shared<std::promise<void> >();
+        sort(strptr, depth, [promise]() { promise->set_value(); });
+        return promise->get_future();
+    }
+
+    //! sort a generic StringSet, allocating the shadow array, which is freed
+    //! before the returned future becomes ready.
+    template <typename StringSet>
+    std::future<void> sort_base(const StringSet& strset, size_t depth = 0)
+    {
+        typedef stringtools::StringShadowPtr<StringSet> StringShadowPtr;
+        typedef typename StringSet::Container Container;
+
+        // the shadow array lives on the heap, since some Containers are
+        // neither copyable nor movable without invalidating the StringSet.
+        auto shadow = std::make_shared<Container>(
+            strset.allocate(strset.size()));
+        auto promise = std::make_shared<std::promise<void> >();
+
+        sort(StringShadowPtr(strset, StringSet(*shadow)), depth,
+             [promise, shadow]() {
+                 StringSet::deallocate(*shadow);
+                 promise->set_value();
+             });
+        return promise->get_future();
+    }
+
+protected:
+    //! one sort in flight with its Context and key cache, deletes itself
+    //! when done.
+    template <typename StringPtr>
+    class Sort : public JobQueuePool::Client
+    {
+    public:
+        typedef Context<StringPtr::with_lcp, AsyncJobQueueGroup> context_type;
+        typedef typename Classify<bingmann_sample_sort::DefaultTreebits>::key_type
+            key_type;
+
+        Sort(JobQueuePool& pool, const StringPtr& strptr, size_t depth,
+             const std::function<void()>& done)
+            : m_group(&pool), m_ctx(&m_group), m_done(done)
+        {
+            m_ctx.threadnum = pool.size();
+            m_keys = parallel_sample_sort_start<Classify>(m_ctx, strptr, depth);
+            pool.attach(this);
+        }
+
+        bool try_run() final
+        {
+            return m_ctx.jobqueue.try_run();
+        }
+
+        size_t queued() const final
+        {
+            return m_ctx.jobqueue.queued();
+        }
+
+        bool finished() const final
+        {
+            return m_ctx.jobqueue.finished();
+        }
+
+        void complete() final
+        {
+            parallel_sample_sort_finish(m_ctx, m_keys);
+            std::function<void()> done = std::move(m_done);
+            delete this;
+            done();
+        }
+
+    protected:
+        typename context_type::jobqueuegroup_type m_group;
+        context_type m_ctx;
+        key_type* m_keys;
+        std::function<void()> m_done;
+    };
+
+    //! threads running the jobs of all sorts in flight
+    JobQueuePool m_pool;
+};
+
 //! Call for NUMA aware parallel sorting
 static inline
 void parallel_sample_sort_numa(string* strings, size_t n,
@@ -1633,7 +3172,7 @@ void parallel_sample_sort_numa(string* strings, size_t n,
     StringShadowLcpCacheOutPtr<StringSet> strptr(
         strset, outputss, outputss, output.lcps, output.cachedChars);
 
-    Enqueue<bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX>(
+    Enqueue<bingmann_sample_sort::ClassifyRadixLookupX>(
         ctx, NULL, strptr, 0);
     ctx.jobqueue.numaLoop(numaNode, numberOfThreads);
 
@@ -1670,7 +3209,7 @@ void parallel_sample_sort_numa2(const UCharStringShadowLcpCacheOutPtr* strptr,
         if (ctx[i]->threadnum == 0)
             ctx[i]->threadnum = 1;
 
-        Enqueue<bingmann_sample_sort::ClassifyTreeCalcUnrollInterleaveX>(
+        Enqueue<bingmann_sample_sort::ClassifyRadixLookupX>(
             *ctx[i], NULL, strptr[i], 0);
 
         group.add_jobqueue(&ctx[i]->jobqueue);
@@ -1685,7 +3224,7 @@ void parallel_sample_sort_numa2(const UCharStringShadowLcpCacheOutPtr* strptr,
         strptr[i].set_cache(0, strptr[i].out(0)[0]);
 
 #if PS5_ENABLE_RESTSIZE
-        assert(ctx[i].restsize.update().get() == 0);
+        assert(ctx[i]->restsize.update().get() == 0);
 #endif
 
         delete ctx[i];
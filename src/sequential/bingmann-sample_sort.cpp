@@ -27,6 +27,9 @@
 #include "bingmann-sample_sortBTC.hpp"
 #include "bingmann-sample_sortBTCE.hpp"
 #include "bingmann-sample_sortBTCT.hpp"
+#include "bingmann-sample_sortKTC.hpp"
+#include "bingmann-sample_sortLC.hpp"
+#include "bingmann-sample_sortRL.hpp"
 
 #include <tlx/die.hpp>
 
@@ -39,6 +42,8 @@ namespace bingmann_sample_sort {
 template <typename Classify>
 void sample_sort_generic(string* strings, size_t n, size_t depth)
 {
+    typedef typename Classify::key_type key_type;
+
     if (n < g_samplesort_smallsort)
     {
         sample_sort_small_sort(strings, n, depth);
@@ -198,6 +203,48 @@ void bingmann_sample_sortBTCTUI(string* strings, size_t n)
     sample_sort_generic<Classify>(strings, n, 0);
 }
 
+void bingmann_sample_sortBTCT128(string* strings, size_t n)
+{
+    using Classify = ClassifyTreeCalcUnrollInterleave128X<DefaultTreebits>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
+void bingmann_sample_sortBTCTG(string* strings, size_t n)
+{
+    using Classify = ClassifyTreeCalcGather<>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+void bingmann_sample_sortKTC(string* strings, size_t n)
+{
+    using Classify = ClassifyKaryTree<>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
+void bingmann_sample_sortKTC16(string* strings, size_t n)
+{
+    using Classify = ClassifyKaryTree<DefaultTreebits, 16>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+void bingmann_sample_sortLC(string* strings, size_t n)
+{
+    using Classify = ClassifyLearned<>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+
+void bingmann_sample_sortRL(string* strings, size_t n)
+{
+    using Classify = ClassifyRadixLookup<>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
 /*----------------------------------------------------------------------------*/
 
 void bingmann_sample_sortBTCE(string* strings, size_t n)
@@ -224,6 +271,12 @@ void bingmann_sample_sortBTCEV(string* strings, size_t n)
     sample_sort_generic<Classify>(strings, n, 0);
 }
 
+void bingmann_sample_sortBTCEB(string* strings, size_t n)
+{
+    using Classify = ClassifyEqualBranchless<>;
+    sample_sort_generic<Classify>(strings, n, 0);
+}
+
 /******************************************************************************/
 // sample_sort Instances to Optimize Classifier Size and Interleave Count
 
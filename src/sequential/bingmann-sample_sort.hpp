@@ -68,6 +68,42 @@ void sample_sort_small_sort(string* strings, size_t n, size_t depth)
     bingmann::msd_CI(strings, n, depth);
 }
 
+//! Issue software prefetches for the classify() loops: called for the keys at
+//! position i, it prefetches the characters at depth of the num strings
+//! g_prefetch_distance positions ahead, and the String objects twice as far
+//! ahead for string sets with an extra indirection.
+template <typename StringSet>
+static inline void
+prefetch_keys(const StringSet& strset,
+              const typename StringSet::Iterator& i,
+              const typename StringSet::Iterator& end,
+              size_t depth, size_t num = 1)
+{
+    const size_t dist = g_prefetch_distance;
+    if (dist == 0) return;
+
+    const size_t left = end - i;
+
+    for (size_t u = dist; u < dist + num && u < left; ++u)
+        strset.prefetch_chars(i[u], depth);
+
+    for (size_t u = 2 * dist; u < 2 * dist + num && u < left; ++u)
+        strset.prefetch_string(i[u]);
+}
+
+//! Software prefetches for the classify() loops on plain string arrays.
+static inline void
+prefetch_keys(string* i, string* end, size_t depth, size_t num = 1)
+{
+    const size_t dist = g_prefetch_distance;
+    if (dist == 0) return;
+
+    const size_t left = end - i;
+
+    for (size_t u = dist; u < dist + num && u < left; ++u)
+        __builtin_prefetch(i[u] + depth);
+}
+
 // ---[ Implementations ]-------------------------------------------------------
 
 void bingmann_sample_sortBSC(string* strings, size_t n);
@@ -81,9 +117,18 @@ void bingmann_sample_sortBTCU4(string* strings, size_t n);
 
 void bingmann_sample_sortBTCE(string* strings, size_t n);
 void bingmann_sample_sortBTCEA(string* strings, size_t n);
+void bingmann_sample_sortBTCEB(string* strings, size_t n);
 
 void bingmann_sample_sortBTCT(string* strings, size_t n);
 void bingmann_sample_sortBTCTU(string* strings, size_t n);
+void bingmann_sample_sortBTCT128(string* strings, size_t n);
+void bingmann_sample_sortBTCTG(string* strings, size_t n);
+
+void bingmann_sample_sortKTC(string* strings, size_t n);
+void bingmann_sample_sortKTC16(string* strings, size_t n);
+
+void bingmann_sample_sortLC(string* strings, size_t n);
+void bingmann_sample_sortRL(string* strings, size_t n);
 
 } // namespace bingmann_sample_sort
 
@@ -37,6 +37,8 @@ template <size_t treebits = DefaultTreebits>
 class ClassifyBinarySearch
 {
 public:
+    typedef uint64_t key_type;
+
     // NOTE: for binary search numsplitters need not be 2^k-1, any size will
     // do, but the tree implementations are always faster, so we keep this only
     // for historical reasons.
@@ -72,6 +74,7 @@ public:
     {
         for (string* str = strB; str != strE; )
         {
+            prefetch_keys(str, strE, depth);
             key_type key = get_char<key_type>(*str++, depth);
             *bktout++ = find_bkt_tree(key);
         }
@@ -86,6 +89,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt_tree(key);
         }
@@ -35,6 +35,8 @@ template <size_t TreeBits = DefaultTreebits>
 class ClassifyTreeSimple
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -80,6 +82,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -108,10 +111,14 @@ public:
     }
 };
 
+//! Tree descent in inline assembler. ClassifyTreeUnrollInterleave is the
+//! branchless C++ version, which also interleaves several keys.
 template <size_t TreeBits = DefaultTreebits>
 class ClassifyTreeAssembler
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -154,6 +161,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -186,6 +194,8 @@ template <size_t TreeBits = DefaultTreebits>
 class ClassifyTreeUnroll
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -233,6 +243,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -367,6 +378,8 @@ public:
         {
             if (begin + Rollout < end)
             {
+                prefetch_keys(strset, begin, end, depth, Rollout);
+
                 key_type key[Rollout];
                 for (size_t u = 0; u < Rollout; ++u)
                     key[u] = strset.get_uint64(begin[u], depth);
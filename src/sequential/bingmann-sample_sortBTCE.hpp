@@ -34,6 +34,8 @@ template <size_t TreeBits = DefaultTreebits>
 class ClassifyEqual
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -67,6 +69,7 @@ public:
     {
         for (string* str = strB; str != strE; )
         {
+            prefetch_keys(str, strE, depth);
             key_type key = get_char<key_type>(*str++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -81,6 +84,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -89,8 +93,9 @@ public:
     //! return a splitter
     key_type get_splitter(unsigned int i) const
     {
+        // the i-th splitter has in-order rank i + 1
         return splitter_tree[
-            TreeCalculations < treebits > ::pre_to_levelorder(i)];
+            TreeCalculations < treebits > ::pre_to_levelorder(i + 1)];
     }
 
     /// build tree and splitter array from sample
@@ -105,6 +110,8 @@ template <size_t TreeBits = DefaultTreebits>
 class ClassifyEqualAssembler
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -192,6 +199,7 @@ public:
     {
         for (string* str = strB; str != strE; )
         {
+            prefetch_keys(str, strE, depth);
             key_type key = get_char<key_type>(*str++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -206,6 +214,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -214,7 +223,9 @@ public:
     //! return a splitter
     key_type get_splitter(unsigned int i) const
     {
-        return splitter_tree[TreeCalculations < treebits > ::pre_to_levelorder(i)];
+        // the i-th splitter has in-order rank i + 1
+        return splitter_tree[
+            TreeCalculations < treebits > ::pre_to_levelorder(i + 1)];
     }
 
     /// build tree and splitter array from sample
@@ -229,6 +240,8 @@ template <size_t TreeBits = DefaultTreebits>
 class ClassifyEqualUnroll
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -297,6 +310,7 @@ public:
     {
         for (string* str = strB; str != strE; )
         {
+            prefetch_keys(str, strE, depth);
             key_type key = get_char<key_type>(*str++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -311,6 +325,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -319,8 +334,9 @@ public:
     //! return a splitter
     key_type get_splitter(unsigned int i) const
     {
+        // the i-th splitter has in-order rank i + 1
         return splitter_tree[
-            TreeCalculations < treebits > ::pre_to_levelorder(i)];
+            TreeCalculations < treebits > ::pre_to_levelorder(i + 1)];
     }
 
     /// build tree and splitter array from sample
@@ -335,6 +351,8 @@ template <size_t TreeBits = DefaultTreebits>
 class ClassifyEqualUnrollAssembler
 {
 public:
+    typedef uint64_t key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -350,6 +368,7 @@ public:
     {
         for (string* str = strB; str != strE; )
         {
+            prefetch_keys(str, strE, depth);
             key_type key = get_char<key_type>(*str++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -364,6 +383,7 @@ public:
     {
         while (begin != end)
         {
+            prefetch_keys(strset, begin, end, depth);
             key_type key = strset.get_uint64(*begin++, depth);
             *bktout++ = find_bkt(key);
         }
@@ -372,7 +392,9 @@ public:
     //! return a splitter
     key_type get_splitter(unsigned int i) const
     {
-        return splitter_tree[TreeCalculations < treebits > ::pre_to_levelorder(i)];
+        // the i-th splitter has in-order rank i + 1
+        return splitter_tree[
+            TreeCalculations < treebits > ::pre_to_levelorder(i + 1)];
     }
 
     /// build tree and splitter array from sample
@@ -818,6 +840,130 @@ ClassifyEqualUnrollAssembler<15>::find_bkt(const key_type& key) const
 #undef SPLITTER_TREE_STEP
 #undef SPLITTER_TREE_END
 
+/*!
+ * Branchless C++ replacement of ClassifyEqualUnrollAssembler for any treebits:
+ * the level-order splitter tree is descended with SETA/LEA steps for Rollout
+ * keys at once, while CMOVs record the first node equal to each key. The
+ * descent stops early only if all Rollout keys have hit an equal node. This
+ * lets the compiler interleave and inline the key loads of any StringSet.
+ */
+template <size_t TreeBits = DefaultTreebits, size_t Rollout = 4>
+class ClassifyEqualBranchless
+{
+public:
+    typedef uint64_t key_type;
+
+    static const size_t treebits = TreeBits;
+    static const size_t numsplitters = (1 << treebits) - 1;
+
+    key_type splitter_tree[numsplitters + 1];
+
+    //! binary search on splitter array for bucket number
+    unsigned int find_bkt(const key_type& key) const
+    {
+        unsigned int i = 1;
+
+        for (size_t l = 0; l < treebits; ++l)
+        {
+            if (TLX_UNLIKELY(key == splitter_tree[i]))
+                return 2 * TreeCalculations<treebits>::level_to_preorder(i) - 1;
+
+            i = 2 * i + (key <= splitter_tree[i] ? 0 : 1);
+        }
+
+        i -= numsplitters + 1;
+        return 2 * i; // < or > bucket
+    }
+
+    //! search in splitter tree for bucket number, unrolled for Rollout keys at
+    //! once.
+    __attribute__ ((optimize("unroll-all-loops")))
+    void find_bkt_unroll(const key_type key[Rollout], uint16_t obkt[Rollout]) const
+    {
+        unsigned int i[Rollout], eq[Rollout];
+        std::fill(i, i + Rollout, 1u);
+        std::fill(eq, eq + Rollout, 0u);
+
+        for (size_t l = 0; l < treebits; ++l)
+        {
+            bool all_eq = true;
+
+            for (size_t u = 0; u < Rollout; ++u)
+            {
+                key_type s = splitter_tree[i[u]];
+                eq[u] = (eq[u] == 0 && key[u] == s) ? i[u] : eq[u];
+                all_eq &= (eq[u] != 0);
+                i[u] = 2 * i[u] + (key[u] <= s ? 0 : 1);
+            }
+
+            if (TLX_UNLIKELY(all_eq)) break;
+        }
+
+        for (size_t u = 0; u < Rollout; ++u)
+        {
+            obkt[u] = eq[u]
+                      ? 2 * TreeCalculations<treebits>::level_to_preorder(eq[u]) - 1
+                      : 2 * (i[u] - (numsplitters + 1));
+        }
+    }
+
+    //! classify all strings in area by walking tree and saving bucket id
+    template <typename StringSet>
+    __attribute__ ((optimize("unroll-all-loops")))
+    void classify(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        while (begin + Rollout <= end)
+        {
+            prefetch_keys(strset, begin, end, depth, Rollout);
+
+            key_type key[Rollout];
+            for (size_t u = 0; u < Rollout; ++u)
+                key[u] = strset.get_uint64(begin[u], depth);
+
+            find_bkt_unroll(key, bktout);
+
+            begin += Rollout;
+            bktout += Rollout;
+        }
+        while (begin != end)
+        {
+            key_type key = strset.get_uint64(*begin++, depth);
+            *bktout++ = find_bkt(key);
+        }
+    }
+
+    //! classify all strings in area by walking tree and saving bucket id
+    void classify(string* strB, string* strE, uint16_t* bktout,
+                  size_t depth)
+    {
+        return classify(
+            parallel_string_sorting::UCharStringSet(strB, strE),
+            strB, strE, bktout, depth);
+    }
+
+    //! return a splitter
+    key_type get_splitter(unsigned int i) const
+    {
+        // the i-th splitter has in-order rank i + 1
+        return splitter_tree[
+            TreeCalculations < treebits > ::pre_to_levelorder(i + 1)];
+    }
+
+    /// build tree and splitter array from sample
+    void
+    build(key_type* samples, size_t samplesize, unsigned char* splitter_lcp)
+    {
+        TreeBuilderLevelOrder<numsplitters>(
+            splitter_tree, splitter_lcp, samples, samplesize);
+    }
+};
+
+template <size_t TreeBits>
+using ClassifyEqualBranchlessX = ClassifyEqualBranchless<TreeBits>;
+
 } // namespace bingmann_sample_sort
 
 #endif // !PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTBTCE_HEADER
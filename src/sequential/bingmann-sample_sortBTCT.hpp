@@ -28,13 +28,17 @@
 #include "bingmann-sample_sort.hpp"
 #include "bingmann-sample_sort_tree_builder.hpp"
 #include "../tools/stringset.hpp"
+#include "../tools/cpu_features.hpp"
 
 namespace bingmann_sample_sort {
 
-template <size_t TreeBits = DefaultTreebits>
+template <size_t TreeBits = DefaultTreebits, typename KeyType = key_type>
 class ClassifyTreeCalcSimple
 {
 public:
+    //! type of keys compared in the splitter tree: uint64_t or uint128_t
+    typedef KeyType key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -79,7 +83,9 @@ public:
     {
         while (begin != end)
         {
-            key_type key = strset.get_uint64(*begin++, depth);
+            prefetch_keys(strset, begin, end, depth);
+            key_type key = parallel_string_sorting::get_key<key_type>(
+                strset, *begin++, depth);
             *bktout++ = find_bkt(key);
         }
     }
@@ -104,15 +110,17 @@ public:
     void build(key_type* samples, size_t samplesize,
                unsigned char* splitter_lcp)
     {
-        bingmann_sample_sort::TreeBuilderLevelOrder<numsplitters>(
+        bingmann_sample_sort::TreeBuilderLevelOrder<numsplitters, key_type>(
             splitter_tree, splitter_lcp, samples, samplesize);
     }
 };
 
-template <size_t TreeBits = DefaultTreebits>
+template <size_t TreeBits = DefaultTreebits, typename KeyType = key_type>
 class ClassifyTreeCalcUnroll
 {
 public:
+    typedef KeyType key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
@@ -198,7 +206,9 @@ public:
     {
         while (begin != end)
         {
-            key_type key = strset.get_uint64(*begin++, depth);
+            prefetch_keys(strset, begin, end, depth);
+            key_type key = parallel_string_sorting::get_key<key_type>(
+                strset, *begin++, depth);
             *bktout++ = find_bkt(key);
         }
     }
@@ -223,20 +233,24 @@ public:
     void build(
         key_type* samples, size_t samplesize, unsigned char* splitter_lcp)
     {
-        bingmann_sample_sort::TreeBuilderLevelOrder<numsplitters>(
+        bingmann_sample_sort::TreeBuilderLevelOrder<numsplitters, key_type>(
             splitter_tree, splitter_lcp,
             samples, samplesize);
     }
 };
 
-template <size_t TreeBits = DefaultTreebits, unsigned Rollout = 4>
-class ClassifyTreeCalcUnrollInterleave : public ClassifyTreeCalcSimple<TreeBits>
+template <size_t TreeBits = DefaultTreebits, unsigned Rollout = 4,
+          typename KeyType = key_type>
+class ClassifyTreeCalcUnrollInterleave
+    : public ClassifyTreeCalcSimple<TreeBits, KeyType>
 {
 public:
+    typedef KeyType key_type;
+
     static const size_t treebits = TreeBits;
     static const size_t numsplitters = (1 << treebits) - 1;
 
-    using Super = ClassifyTreeCalcSimple<TreeBits>;
+    using Super = ClassifyTreeCalcSimple<TreeBits, KeyType>;
     using Super::splitter_tree;
     using Super::get_splitter;
 
@@ -336,9 +350,12 @@ public:
         {
             if (begin + Rollout < end)
             {
+                prefetch_keys(strset, begin, end, depth, Rollout);
+
                 key_type key[Rollout];
                 for (size_t u = 0; u < Rollout; ++u)
-                    key[u] = strset.get_uint64(begin[u], depth);
+                    key[u] = parallel_string_sorting::get_key<key_type>(
+                        strset, begin[u], depth);
 
                 find_bkt_unroll(key, bktout);
 
@@ -347,7 +364,8 @@ public:
             }
             else
             {
-                key_type key = strset.get_uint64(*begin++, depth);
+                key_type key = parallel_string_sorting::get_key<key_type>(
+                    strset, *begin++, depth);
                 *bktout++ = this->find_bkt(key);
             }
         }
@@ -366,6 +384,242 @@ template <size_t TreeBits>
 using ClassifyTreeCalcUnrollInterleaveX =
           ClassifyTreeCalcUnrollInterleave<TreeBits>;
 
+//! interleaved tree descent on 16-byte keys, for inputs with long common
+//! prefixes: each recursion level advances up to 16 characters.
+template <size_t TreeBits>
+using ClassifyTreeCalcUnrollInterleave128X =
+          ClassifyTreeCalcUnrollInterleave<TreeBits, 4, uint128_t>;
+
+/*!
+ * Splitter tree descent with SIMD gathers: the level-order tree of
+ * ClassifyTreeCalcSimple is walked for a whole vector of keys at once, using
+ * vpgatherqq to fetch splitter_tree[i] and a vector compare to compute the next
+ * index i = 2 * i + (key > splitter). AVX-512 processes 8 keys per vector,
+ * AVX2 4 keys. Rollout vectors are interleaved to hide the gather latency.
+ *
+ * The equal bucket is detected without a second tree lookup: the splitter of
+ * the last left branch taken is the smallest splitter >= key, which is exactly
+ * get_splitter(i) at the leaf.
+ *
+ * The kernel is selected at runtime by cpu_features::selected_isa(); CPUs
+ * without AVX2 use the scalar interleaved descent.
+ */
+template <size_t TreeBits = DefaultTreebits, unsigned Rollout = 4>
+class ClassifyTreeCalcGather : public ClassifyTreeCalcUnrollInterleave<TreeBits>
+{
+public:
+    //! the SIMD kernels compare 64-bit keys only
+    typedef uint64_t key_type;
+
+    static const size_t treebits = TreeBits;
+    static const size_t numsplitters = (1 << treebits) - 1;
+
+    using Super = ClassifyTreeCalcUnrollInterleave<TreeBits>;
+    using Super::splitter_tree;
+
+#if PSS_CPU_DISPATCH
+
+    //! search in splitter tree for bucket numbers of Rollout * 8 keys
+    PSS_TARGET_AVX512
+    void find_bkt_gather_avx512(const key_type* key, uint16_t* obkt) const
+    {
+        static const size_t vecsize = 8;
+
+        const long long* tree =
+            reinterpret_cast<const long long*>(splitter_tree);
+
+        const __m512i one = _mm512_set1_epi64(1);
+
+        __m512i k[Rollout], i[Rollout], last[Rollout];
+        __mmask8 left[Rollout];
+
+        for (unsigned u = 0; u < Rollout; ++u) {
+            k[u] = _mm512_loadu_si512(key + u * vecsize);
+            i[u] = one;
+            last[u] = _mm512_setzero_si512();
+            left[u] = 0;
+        }
+
+        for (size_t l = 0; l < treebits; ++l)
+        {
+            for (unsigned u = 0; u < Rollout; ++u)
+            {
+                __m512i s = _mm512_i64gather_epi64(i[u], tree, 8);
+                __mmask8 gt = _mm512_cmpgt_epu64_mask(k[u], s);
+                // remember splitter of last left branch
+                last[u] = _mm512_mask_mov_epi64(s, gt, last[u]);
+                left[u] |= ~gt;
+                i[u] = _mm512_add_epi64(i[u], i[u]);
+                i[u] = _mm512_mask_add_epi64(i[u], gt, i[u], one);
+            }
+        }
+
+        const __m512i base = _mm512_set1_epi64(numsplitters + 1);
+
+        for (unsigned u = 0; u < Rollout; ++u)
+        {
+            __mmask8 eq = _mm512_mask_cmpeq_epi64_mask(left[u], k[u], last[u]);
+            // b = 2 * (i - numsplitters - 1) + (key == splitter)
+            __m512i b = _mm512_sub_epi64(i[u], base);
+            b = _mm512_add_epi64(b, b);
+            b = _mm512_mask_add_epi64(b, eq, b, one);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(obkt + u * vecsize),
+                             _mm512_cvtepi64_epi16(b));
+        }
+    }
+
+    //! search in splitter tree for bucket numbers of Rollout * 4 keys
+    PSS_TARGET_AVX2
+    void find_bkt_gather_avx2(const key_type* key, uint16_t* obkt) const
+    {
+        static const size_t vecsize = 4;
+
+        const long long* tree =
+            reinterpret_cast<const long long*>(splitter_tree);
+
+        // AVX2 has only signed 64-bit compares: flip the sign bits
+        const __m256i sign = _mm256_set1_epi64x(0x8000000000000000LL);
+
+        __m256i k[Rollout], i[Rollout], last[Rollout], left[Rollout];
+
+        for (unsigned u = 0; u < Rollout; ++u) {
+            k[u] = _mm256_xor_si256(
+                _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(key + u * vecsize)),
+                sign);
+            i[u] = _mm256_set1_epi64x(1);
+            last[u] = _mm256_setzero_si256();
+            left[u] = _mm256_setzero_si256();
+        }
+
+        for (size_t l = 0; l < treebits; ++l)
+        {
+            for (unsigned u = 0; u < Rollout; ++u)
+            {
+                __m256i s = _mm256_xor_si256(
+                    _mm256_i64gather_epi64(tree, i[u], 8), sign);
+                // gt = all ones if key > splitter
+                __m256i gt = _mm256_cmpgt_epi64(k[u], s);
+                // remember splitter of last left branch
+                last[u] = _mm256_blendv_epi8(s, last[u], gt);
+                left[u] = _mm256_or_si256(left[u], _mm256_xor_si256(
+                                              gt, _mm256_set1_epi64x(-1)));
+                // i = 2 * i + 1 if key > splitter, subtracting gt = -1
+                i[u] = _mm256_sub_epi64(_mm256_add_epi64(i[u], i[u]), gt);
+            }
+        }
+
+        const __m256i base = _mm256_set1_epi64x(numsplitters + 1);
+
+        for (unsigned u = 0; u < Rollout; ++u)
+        {
+            __m256i eq = _mm256_and_si256(
+                left[u], _mm256_cmpeq_epi64(k[u], last[u]));
+            // b = 2 * (i - numsplitters - 1) + (key == splitter)
+            __m256i b = _mm256_sub_epi64(i[u], base);
+            b = _mm256_sub_epi64(_mm256_add_epi64(b, b), eq);
+
+            uint64_t ob[vecsize];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(ob), b);
+            for (size_t v = 0; v < vecsize; ++v)
+                obkt[u * vecsize + v] = ob[v];
+        }
+    }
+
+    //! classify blocks of BlockSize strings with find_bkt_block(), the rest
+    //! with the scalar tree descent.
+    template <size_t BlockSize, typename StringSet, typename FindBktBlock>
+    void classify_blocks(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth, const FindBktBlock& find_bkt_block) const
+    {
+        while (begin + BlockSize <= end)
+        {
+            prefetch_keys(strset, begin, end, depth, BlockSize);
+
+            key_type key[BlockSize];
+            for (size_t u = 0; u < BlockSize; ++u)
+                key[u] = strset.get_uint64(begin[u], depth);
+
+            find_bkt_block(key, bktout);
+
+            begin += BlockSize;
+            bktout += BlockSize;
+        }
+        while (begin != end)
+        {
+            key_type key = strset.get_uint64(*begin++, depth);
+            *bktout++ = this->find_bkt(key);
+        }
+    }
+
+    //! AVX-512 kernel of classify()
+    template <typename StringSet>
+    PSS_TARGET_AVX512 PSS_FLATTEN
+    void classify_avx512(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        classify_blocks<Rollout * 8>(
+            strset, begin, end, bktout, depth,
+            [this](const key_type* key, uint16_t* obkt) {
+                find_bkt_gather_avx512(key, obkt);
+            });
+    }
+
+    //! AVX2 kernel of classify()
+    template <typename StringSet>
+    PSS_TARGET_AVX2 PSS_FLATTEN
+    void classify_avx2(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        classify_blocks<Rollout * 4>(
+            strset, begin, end, bktout, depth,
+            [this](const key_type* key, uint16_t* obkt) {
+                find_bkt_gather_avx2(key, obkt);
+            });
+    }
+
+#endif // PSS_CPU_DISPATCH
+
+    //! classify all strings in area by walking tree and saving bucket id
+    template <typename StringSet>
+    void classify(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+#if PSS_CPU_DISPATCH
+        switch (cpu_features::selected_isa())
+        {
+        case cpu_features::ISA_AVX512:
+            return classify_avx512(strset, begin, end, bktout, depth);
+        case cpu_features::ISA_AVX2:
+            return classify_avx2(strset, begin, end, bktout, depth);
+        default:
+            break;
+        }
+#endif
+        return Super::classify(strset, begin, end, bktout, depth);
+    }
+
+    //! classify all strings in area by walking tree and saving bucket id
+    void classify(string* strB, string* strE, uint16_t* bktout, size_t depth)
+    {
+        return classify(
+            parallel_string_sorting::UCharStringSet(strB, strE),
+            strB, strE, bktout, depth);
+    }
+};
+
+template <size_t TreeBits>
+using ClassifyTreeCalcGatherX =
+          ClassifyTreeCalcGather<TreeBits>;
+
 } // namespace bingmann_sample_sort
 
 #endif // !PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTBTCT_HEADER
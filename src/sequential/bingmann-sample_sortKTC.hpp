@@ -0,0 +1,389 @@
+/*******************************************************************************
+ * src/sequential/bingmann-sample_sortKTC.hpp
+ *
+ * Experiments with sequential Super Scalar String Sample-Sort (S^5).
+ *
+ * K-ary search tree with SIMD node compares and bucket cache.
+ *
+ *******************************************************************************
+ * Copyright (C) 2013-2017 Timo Bingmann <tb@panthema.net>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTKTC_HEADER
+#define PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTKTC_HEADER
+
+#include "bingmann-sample_sort.hpp"
+#include "bingmann-sample_sort_tree_builder.hpp"
+#include "../tools/stringset.hpp"
+#include "../tools/cpu_features.hpp"
+
+namespace bingmann_sample_sort {
+
+/*!
+ * Classifier storing the splitters as a static (B+1)-ary search tree, where
+ * each node holds NodeKeys = B splitters in one or two cache lines. Nodes are
+ * numbered in level-order: the children of node k are k * (B+1) + i + 1 for
+ * i = 0..B, and the keys are filled in by an in-order traversal (an implicit
+ * B-tree, or "S-tree"). With 1023 splitters the tree has 128 nodes of 8 keys
+ * or 64 nodes of 16 keys, and a key descends through 3-4 nodes instead of 10
+ * binary levels.
+ *
+ * In each node, one SIMD compare plus popcount (SSE4.2, AVX2 or AVX-512, chosen
+ * at runtime by cpu_features::selected_isa()) yields the number i of keys
+ * less than the search key. The slot i is the leftmost key >= search key in
+ * this node, and the last such slot seen on the path is the lower bound of the
+ * key among all splitters. A rank table maps slots back to splitter indexes.
+ *
+ * The tree keys are stored with flipped sign bit, such that signed 64-bit SIMD
+ * compares order them as unsigned keys. The slots after the last splitter are
+ * padded with the maximum key and have rank numsplitters.
+ */
+template <size_t TreeBits = DefaultTreebits, unsigned NodeKeys = 8>
+class ClassifyKaryTree
+{
+public:
+    typedef uint64_t key_type;
+
+    static const size_t treebits = TreeBits;
+    static const size_t numsplitters = (1 << treebits) - 1;
+
+    //! number of keys in a tree node
+    static const size_t nodekeys = NodeKeys;
+
+    //! number of tree nodes
+    static const size_t nodenum = (numsplitters + nodekeys - 1) / nodekeys;
+
+    static_assert(nodekeys == 8 || nodekeys == 16,
+                  "ClassifyKaryTree nodes must have 8 or 16 keys");
+
+    //! calculate number of levels of the tree
+    static constexpr size_t calc_levels(size_t first = 0, size_t levels = 0)
+    {
+        return first < nodenum
+               ? calc_levels(first * (nodekeys + 1) + 1, levels + 1) : levels;
+    }
+
+    //! maximum number of nodes on a path from root to leaf
+    static const size_t levels = calc_levels();
+
+    //! sorted splitters, for equality checks and get_splitter()
+    key_type splitter[numsplitters];
+
+    //! tree nodes, node nodenum is a sentinel for branch-free descents. The
+    //! classifier is allocated with plain new and copied in SmallsortJob's
+    //! stack, hence the nodes are not cache-line aligned and are read with
+    //! unaligned loads.
+    key_type node[(nodenum + 1) * nodekeys];
+
+    //! map from tree slot to splitter index, the extra slot nodenum * nodekeys
+    //! is used if the key is larger than all splitters.
+    uint16_t slot_rank[nodenum * nodekeys + 1];
+
+    //! flip sign bit of a key for signed SIMD compares
+    static key_type flip(const key_type& key)
+    {
+        return key ^ (key_type(1) << (8 * sizeof(key_type) - 1));
+    }
+
+    //! count number of keys in a node which are less than the (flipped) key
+    struct NodeRankGeneric
+    {
+        static unsigned int rank(const key_type* n, const key_type& fkey)
+        {
+            unsigned int r = 0;
+            for (size_t j = 0; j < nodekeys; ++j)
+                r += ((int64_t)n[j] < (int64_t)fkey);
+            return r;
+        }
+    };
+
+#if PSS_CPU_DISPATCH
+
+    //! count number of keys in a node which are less than the (flipped) key
+    struct NodeRankSSE42
+    {
+        PSS_TARGET_SSE42
+        static unsigned int rank(const key_type* n, const key_type& fkey)
+        {
+            const __m128i k = _mm_set1_epi64x(fkey);
+            unsigned int mask = 0;
+            for (size_t j = 0; j < nodekeys / 2; ++j) {
+                __m128i c = _mm_cmpgt_epi64(
+                    k, _mm_loadu_si128(reinterpret_cast<const __m128i*>(n + 2 * j)));
+                mask |= _mm_movemask_pd(_mm_castsi128_pd(c)) << (2 * j);
+            }
+            return __builtin_popcount(mask);
+        }
+    };
+
+    //! count number of keys in a node which are less than the (flipped) key
+    struct NodeRankAVX2
+    {
+        PSS_TARGET_AVX2
+        static unsigned int rank(const key_type* n, const key_type& fkey)
+        {
+            const __m256i k = _mm256_set1_epi64x(fkey);
+            unsigned int mask = 0;
+            for (size_t j = 0; j < nodekeys / 4; ++j) {
+                __m256i c = _mm256_cmpgt_epi64(
+                    k, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(n + 4 * j)));
+                mask |= _mm256_movemask_pd(_mm256_castsi256_pd(c)) << (4 * j);
+            }
+            return __builtin_popcount(mask);
+        }
+    };
+
+    //! count number of keys in a node which are less than the (flipped) key
+    struct NodeRankAVX512
+    {
+        PSS_TARGET_AVX512
+        static unsigned int rank(const key_type* n, const key_type& fkey)
+        {
+            const __m512i k = _mm512_set1_epi64(fkey);
+            unsigned int mask =
+                _mm512_cmplt_epi64_mask(_mm512_loadu_si512(n), k);
+            if (nodekeys == 16) {
+                mask |= (unsigned int)_mm512_cmplt_epi64_mask(
+                    _mm512_loadu_si512(n + 8), k) << 8;
+            }
+            return __builtin_popcount(mask);
+        }
+    };
+
+#endif // PSS_CPU_DISPATCH
+
+    //! search in k-ary tree for the bucket number
+    template <typename NodeRank = NodeRankGeneric>
+    unsigned int find_bkt(const key_type& key) const
+    {
+        const key_type fkey = flip(key);
+
+        size_t k = 0;
+        size_t slot = nodenum * nodekeys; // no slot: rank numsplitters
+
+        while (k < nodenum)
+        {
+            unsigned int i = NodeRank::rank(node + k * nodekeys, fkey);
+            if (i < nodekeys) slot = k * nodekeys + i;
+            k = k * (nodekeys + 1) + i + 1;
+        }
+
+        size_t r = slot_rank[slot];
+
+        size_t b = r * 2;                                     // < bucket
+        if (r < numsplitters && splitter[r] == key) b += 1;   // equal bucket
+
+        return b;
+    }
+
+    //! search in k-ary tree for the bucket numbers of Rollout keys at once.
+    //! All keys descend for the maximum number of levels without branches:
+    //! keys which already reached a leaf stay on the sentinel node nodenum.
+    template <unsigned Rollout, typename NodeRank>
+    __attribute__ ((optimize("unroll-all-loops")))
+    void find_bkt_unroll(const key_type key[Rollout], uint16_t obkt[Rollout]) const
+    {
+        size_t k[Rollout], slot[Rollout];
+        key_type fkey[Rollout];
+
+        for (unsigned u = 0; u < Rollout; ++u) {
+            fkey[u] = flip(key[u]);
+            k[u] = 0;
+            slot[u] = nodenum * nodekeys;
+        }
+
+        for (size_t l = 0; l < levels; ++l)
+        {
+            for (unsigned u = 0; u < Rollout; ++u)
+            {
+                unsigned int i = NodeRank::rank(node + k[u] * nodekeys, fkey[u]);
+                bool valid = (k[u] < nodenum);
+                slot[u] = (valid && i < nodekeys) ? k[u] * nodekeys + i : slot[u];
+                size_t next = k[u] * (nodekeys + 1) + i + 1;
+                k[u] = (next < nodenum) ? next : nodenum;
+            }
+        }
+
+        for (unsigned u = 0; u < Rollout; ++u)
+        {
+            size_t r = slot_rank[slot[u]];
+
+            obkt[u] = r * 2;                                        // < bucket
+            if (r < numsplitters && splitter[r] == key[u]) obkt[u] += 1; // equal
+        }
+    }
+
+    //! classify all strings in area with a node rank kernel
+    template <typename NodeRank, typename StringSet>
+    __attribute__ ((optimize("unroll-all-loops")))
+    void classify_with(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        static const unsigned Rollout = 8;
+
+        while (begin + Rollout <= end)
+        {
+            prefetch_keys(strset, begin, end, depth, Rollout);
+
+            key_type key[Rollout];
+            for (size_t u = 0; u < Rollout; ++u)
+                key[u] = strset.get_uint64(begin[u], depth);
+
+            find_bkt_unroll<Rollout, NodeRank>(key, bktout);
+
+            begin += Rollout;
+            bktout += Rollout;
+        }
+        while (begin != end)
+        {
+            key_type key = strset.get_uint64(*begin++, depth);
+            *bktout++ = find_bkt<NodeRank>(key);
+        }
+    }
+
+#if PSS_CPU_DISPATCH
+
+    //! SSE4.2 kernel of classify()
+    template <typename StringSet>
+    PSS_TARGET_SSE42 PSS_FLATTEN __attribute__ ((optimize("unroll-all-loops")))
+    void classify_sse42(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        classify_with<NodeRankSSE42>(strset, begin, end, bktout, depth);
+    }
+
+    //! AVX2 kernel of classify()
+    template <typename StringSet>
+    PSS_TARGET_AVX2 PSS_FLATTEN __attribute__ ((optimize("unroll-all-loops")))
+    void classify_avx2(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        classify_with<NodeRankAVX2>(strset, begin, end, bktout, depth);
+    }
+
+    //! AVX-512 kernel of classify()
+    template <typename StringSet>
+    PSS_TARGET_AVX512 PSS_FLATTEN __attribute__ ((optimize("unroll-all-loops")))
+    void classify_avx512(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        classify_with<NodeRankAVX512>(strset, begin, end, bktout, depth);
+    }
+
+#endif // PSS_CPU_DISPATCH
+
+    //! classify all strings in area by walking tree and saving bucket id
+    template <typename StringSet>
+    void classify(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+#if PSS_CPU_DISPATCH
+        switch (cpu_features::selected_isa())
+        {
+        case cpu_features::ISA_AVX512:
+            return classify_avx512(strset, begin, end, bktout, depth);
+        case cpu_features::ISA_AVX2:
+            return classify_avx2(strset, begin, end, bktout, depth);
+        case cpu_features::ISA_SSE42:
+            return classify_sse42(strset, begin, end, bktout, depth);
+        default:
+            break;
+        }
+#endif
+        return classify_with<NodeRankGeneric>(strset, begin, end, bktout, depth);
+    }
+
+    //! classify all strings in area by walking tree and saving bucket id
+    void classify(string* strB, string* strE, uint16_t* bktout, size_t depth)
+    {
+        return classify(
+            parallel_string_sorting::UCharStringSet(strB, strE),
+            strB, strE, bktout, depth);
+    }
+
+    //! return a splitter
+    key_type get_splitter(unsigned int i) const
+    {
+        return splitter[i];
+    }
+
+    //! fill k-ary tree nodes by in-order traversal
+    void build_node(size_t k, size_t& rank)
+    {
+        if (k >= nodenum) return;
+
+        for (size_t i = 0; i < nodekeys; ++i)
+        {
+            build_node(k * (nodekeys + 1) + i + 1, rank);
+
+            node[k * nodekeys + i] =
+                flip(rank < numsplitters ? splitter[rank] : ~key_type(0));
+            slot_rank[k * nodekeys + i] =
+                rank < numsplitters ? rank : numsplitters;
+            ++rank;
+        }
+
+        build_node(k * (nodekeys + 1) + nodekeys + 1, rank);
+    }
+
+    //! build tree and splitter array from sample
+    void build(key_type* samples, size_t samplesize,
+               unsigned char* splitter_lcp)
+    {
+        // select splitters and calculate splitter_lcp using the binary tree
+        // builder, then read the sorted splitters from the level-order tree.
+        key_type splitter_tree[numsplitters + 1];
+
+        bingmann_sample_sort::TreeBuilderLevelOrder<numsplitters>(
+            splitter_tree, splitter_lcp, samples, samplesize);
+
+        for (size_t i = 0; i < numsplitters; ++i) {
+            splitter[i] = splitter_tree[
+                TreeCalculations<treebits>::pre_to_levelorder(i + 1)];
+        }
+
+        size_t rank = 0;
+        build_node(0, rank);
+        assert(rank == nodenum * nodekeys);
+
+        // sentinel node and slot
+        std::fill(node + nodenum * nodekeys, node + (nodenum + 1) * nodekeys,
+                  flip(~key_type(0)));
+        slot_rank[nodenum * nodekeys] = numsplitters;
+    }
+};
+
+template <size_t TreeBits>
+using ClassifyKaryTreeX = ClassifyKaryTree<TreeBits, 8>;
+
+template <size_t TreeBits>
+using ClassifyKaryTree16X = ClassifyKaryTree<TreeBits, 16>;
+
+} // namespace bingmann_sample_sort
+
+#endif // !PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTKTC_HEADER
+
+/******************************************************************************/
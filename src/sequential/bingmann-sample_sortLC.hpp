@@ -0,0 +1,251 @@
+/*******************************************************************************
+ * src/sequential/bingmann-sample_sortLC.hpp
+ *
+ * Experiments with sequential Super Scalar String Sample-Sort (S^5).
+ *
+ * Learned classifier: piecewise-linear model of the splitters' CDF.
+ *
+ *******************************************************************************
+ * Copyright (C) 2013-2017 Timo Bingmann <tb@panthema.net>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTLC_HEADER
+#define PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTLC_HEADER
+
+#include "bingmann-sample_sort.hpp"
+#include "bingmann-sample_sortBTC.hpp"
+#include "../tools/stringset.hpp"
+
+namespace bingmann_sample_sort {
+
+/*!
+ * Classifier which computes the rank of a key among the sorted splitters with
+ * a piecewise-linear model of their CDF instead of descending a splitter tree.
+ *
+ * The key range [splitter[0], splitter[numsplitters-1]] is cut into 2^ModelBits
+ * equal-width segments, and the exact splitter rank at each segment boundary
+ * is stored. A key's rank is interpolated linearly within its segment, and
+ * then corrected by a short linear search in the sorted splitter array, hence
+ * the result is always exact. This is fast for high-entropy keys like hashes
+ * and random ids, where the model error is small.
+ *
+ * build() measures the maximum model error on the splitters; if it exceeds
+ * max_error, classify() falls back to the splitter tree of the base class.
+ * Bucket numbers, splitter_lcp, and get_splitter() are the same as for the
+ * tree classifiers: bucket 2 * i for keys between splitter i-1 and i, and
+ * 2 * i + 1 for keys equal to splitter i.
+ */
+template <size_t TreeBits = DefaultTreebits, size_t ModelBits = TreeBits>
+class ClassifyLearned : public ClassifyTreeUnrollInterleave<TreeBits>
+{
+public:
+    static const size_t treebits = TreeBits;
+    static const size_t numsplitters = (1 << treebits) - 1;
+
+    //! number of segments of the piecewise-linear model
+    static const size_t numsegments = size_t(1) << ModelBits;
+
+    //! maximum rank error of the model, above which the tree is used
+    static const size_t max_error = 32;
+
+    using Super = ClassifyTreeUnrollInterleave<TreeBits>;
+    using Super::splitter;
+
+    //! smallest splitter and key range covered by the model
+    key_type key_min, key_range;
+    //! width of the segments in bits
+    unsigned int shift;
+    //! exact rank of the segment boundaries key_min + (j << shift)
+    uint16_t seg_rank[numsegments + 1];
+
+    //! maximum rank error of the model on the splitters
+    unsigned int model_error;
+
+    //! size of the correction search window (a power of two) and the largest
+    //! start of the window inside the splitter array
+    unsigned int search_window, search_lo_max;
+
+    //! whether classify() evaluates the model or descends the tree
+    bool use_model;
+
+    //! evaluate the model: approximate number of splitters less than key
+    unsigned int predict(const key_type& key) const
+    {
+        key_type d = key < key_min ? 0 : key - key_min;
+        if (d > key_range) d = key_range;
+
+        size_t j = d >> shift;
+        key_type off = d - (key_type(j) << shift);
+
+        unsigned int r0 = seg_rank[j], r1 = seg_rank[j + 1];
+
+        return r0 + static_cast<unsigned int>(
+            (static_cast<uint128_t>(off) * (r1 - r0)) >> shift);
+    }
+
+    //! correct the predicted rank p to the number of splitters less than key:
+    //! branchless binary search in a window of 2^search_steps splitters around
+    //! p, which contains the exact rank if the model error bound holds, then a
+    //! linear fix-up which only moves if it does not.
+    unsigned int correct(unsigned int p, const key_type& key) const
+    {
+        unsigned int lo = p > model_error ? p - model_error : 0;
+        lo = std::min(lo, search_lo_max);
+
+        const key_type* base = splitter + lo;
+        for (unsigned int half = search_window / 2; half > 0; half /= 2)
+            base += (base[half - 1] < key) * half;
+        unsigned int i = (base - splitter) + (*base < key);
+
+        while (i < numsplitters && splitter[i] < key) ++i;
+        while (i > 0 && splitter[i - 1] >= key) --i;
+        return i;
+    }
+
+    //! find bucket number by model evaluation and correction search
+    unsigned int find_bkt_model(const key_type& key) const
+    {
+        unsigned int i = correct(predict(key), key);
+
+        unsigned int b = i * 2;                                  // < bucket
+        if (i < numsplitters && splitter[i] == key) b += 1;      // equal bucket
+
+        return b;
+    }
+
+    //! classify all strings in area by model or by walking the tree
+    template <typename StringSet>
+    void classify(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        if (!use_model)
+            return Super::classify(strset, begin, end, bktout, depth);
+
+        static const size_t Rollout = 4;
+
+        while (begin != end)
+        {
+            if (begin + Rollout < end)
+            {
+                prefetch_keys(strset, begin, end, depth, Rollout);
+
+                // evaluate the model for several keys to overlap their loads
+                key_type key[Rollout];
+                unsigned int p[Rollout];
+                for (size_t u = 0; u < Rollout; ++u)
+                    key[u] = strset.get_uint64(begin[u], depth);
+                for (size_t u = 0; u < Rollout; ++u)
+                    p[u] = predict(key[u]);
+                for (size_t u = 0; u < Rollout; ++u) {
+                    unsigned int i = correct(p[u], key[u]);
+                    bktout[u] = 2 * i +
+                                (i < numsplitters && splitter[i] == key[u]);
+                }
+
+                begin += Rollout;
+                bktout += Rollout;
+            }
+            else
+            {
+                prefetch_keys(strset, begin, end, depth);
+                key_type key = strset.get_uint64(*begin++, depth);
+                *bktout++ = find_bkt_model(key);
+            }
+        }
+    }
+
+    //! classify all strings in area by model or by walking the tree
+    void classify(string* strB, string* strE, uint16_t* bktout, size_t depth)
+    {
+        return classify(
+            parallel_string_sorting::UCharStringSet(strB, strE),
+            strB, strE, bktout, depth);
+    }
+
+    //! build tree and splitter array from sample, then fit the model
+    void build(key_type* samples, size_t samplesize,
+               unsigned char* splitter_lcp)
+    {
+        Super::build(samples, samplesize, splitter_lcp);
+
+        key_min = splitter[0];
+        key_range = splitter[numsplitters - 1] - key_min;
+
+        // smallest segment width with key_range >> shift < numsegments
+        shift = 0;
+        while (shift < 64 && (key_range >> shift) >= numsegments)
+            ++shift;
+
+        // exact ranks of segment boundaries: number of splitters less than
+        // key_min + (j << shift), or all splitters beyond the range.
+        size_t i = 0;
+        for (size_t j = 0; j <= numsegments; ++j)
+        {
+            if (j > (key_range >> shift)) {
+                seg_rank[j] = numsplitters;
+                continue;
+            }
+            key_type bound = key_min + (key_type(j) << shift);
+            while (i < numsplitters && splitter[i] < bound) ++i;
+            seg_rank[j] = i;
+        }
+
+        // the model and the exact rank are both monotonic, hence the error is
+        // maximal at the steps of the exact rank: at each splitter and just
+        // behind it.
+        model_error = 0;
+        for (size_t k = 0; k < numsplitters; )
+        {
+            size_t k_end = k + 1;
+            while (k_end < numsplitters && splitter[k_end] == splitter[k])
+                ++k_end;
+
+            model_error = std::max(model_error, rank_error(splitter[k], k));
+            if (splitter[k] != ~key_type(0)) {
+                model_error = std::max(
+                    model_error, rank_error(splitter[k] + 1, k_end));
+            }
+
+            k = k_end;
+        }
+
+        use_model = (model_error <= max_error);
+
+        search_window = 1;
+        while (search_window < 2 * model_error + 2)
+            search_window *= 2;
+        search_lo_max = numsplitters - std::min<size_t>(search_window, numsplitters);
+    }
+
+protected:
+    //! absolute difference of model prediction and exact rank of key
+    unsigned int rank_error(const key_type& key, unsigned int rank) const
+    {
+        unsigned int p = predict(key);
+        return p > rank ? p - rank : rank - p;
+    }
+};
+
+template <size_t TreeBits>
+using ClassifyLearnedX = ClassifyLearned<TreeBits>;
+
+} // namespace bingmann_sample_sort
+
+#endif // !PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTLC_HEADER
+
+/******************************************************************************/
@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * src/sequential/bingmann-sample_sortRL.hpp
+ *
+ * Experiments with sequential Super Scalar String Sample-Sort (S^5).
+ *
+ * Radix lookup classifier: direct table lookup on the leading key bits.
+ *
+ *******************************************************************************
+ * Copyright (C) 2013-2017 Timo Bingmann <tb@panthema.net>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTRL_HEADER
+#define PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTRL_HEADER
+
+#include "bingmann-sample_sort.hpp"
+#include "bingmann-sample_sortBTCT.hpp"
+#include "../tools/stringset.hpp"
+
+#include <vector>
+
+namespace bingmann_sample_sort {
+
+/*!
+ * Classifier which looks up the bucket of a key in a table indexed by the
+ * leading lookup_bits (up to 16) bits of the key instead of descending the
+ * splitter tree of the Tree classifier it derives from.
+ *
+ * The table stores for each prefix the number of splitters with a smaller
+ * prefix. If no splitter has the key's prefix, the bucket follows directly from
+ * one load. Otherwise, the prefix is ambiguous and the key is searched among
+ * the few splitters sharing its prefix.
+ *
+ * build() estimates the average number of splitters sharing a key's prefix from
+ * the samples, which is small if the leading bytes are close to uniform. If it
+ * exceeds max_search, the table is dropped and classify() descends the
+ * splitter tree of the Tree class. Hence each sort step picks the lookup by
+ * itself. Bucket numbers, splitter_lcp, and get_splitter() are the same as for
+ * the tree classifiers.
+ */
+template <size_t TreeBits = DefaultTreebits,
+          template <size_t> class Tree = ClassifyTreeCalcGatherX>
+class ClassifyRadixLookup : public Tree<TreeBits>
+{
+public:
+    static const size_t treebits = TreeBits;
+    static const size_t numsplitters = (1 << treebits) - 1;
+
+    //! number of key bits indexing the lookup table: at most 16, and few
+    //! enough that building the table is cheap compared to classifying the
+    //! strings of a sort step with this tree size.
+    static const size_t lookup_bits = treebits + 4 < 16 ? treebits + 4 : 16;
+    static const size_t lookup_size = size_t(1) << lookup_bits;
+
+    //! largest estimated average number of splitters sharing a key's prefix
+    //! for which the lookup table is used
+    static const size_t max_search = 1;
+
+    using Super = Tree<TreeBits>;
+
+    //! sorted splitters, copied from the level-order tree
+    key_type splitter[numsplitters];
+
+    //! number of splitters with prefix less than the index, lookup_size + 1
+    //! entries, or empty if the tree is used.
+    std::vector<uint16_t> prefix_rank;
+
+    //! return the table index of a key
+    static unsigned int prefix(const key_type& key)
+    {
+        return static_cast<unsigned int>(
+            key >> (8 * sizeof(key_type) - lookup_bits));
+    }
+
+    //! find bucket number by table lookup and, for ambiguous prefixes, binary
+    //! search among the splitters with the same prefix.
+    unsigned int find_bkt_lookup(const key_type& key) const
+    {
+        unsigned int p = prefix(key);
+        unsigned int lo = prefix_rank[p], hi = prefix_rank[p + 1];
+
+        // lower_bound of key in splitter[lo, hi)
+        while (lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+            if (splitter[mid] < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        unsigned int b = lo * 2;                                 // < bucket
+        if (lo < prefix_rank[p + 1] && splitter[lo] == key) b += 1; // equal bucket
+
+        return b;
+    }
+
+    //! classify all strings in area by table lookup or by walking the tree
+    template <typename StringSet>
+    void classify(
+        const StringSet& strset,
+        typename StringSet::Iterator begin, typename StringSet::Iterator end,
+        uint16_t* bktout, size_t depth) const
+    {
+        if (prefix_rank.empty())
+            return Super::classify(strset, begin, end, bktout, depth);
+
+        while (begin != end)
+        {
+            prefetch_keys(strset, begin, end, depth);
+            key_type key = strset.get_uint64(*begin++, depth);
+            *bktout++ = find_bkt_lookup(key);
+        }
+    }
+
+    //! classify all strings in area by table lookup or by walking the tree
+    void classify(string* strB, string* strE, uint16_t* bktout, size_t depth)
+    {
+        return classify(
+            parallel_string_sorting::UCharStringSet(strB, strE),
+            strB, strE, bktout, depth);
+    }
+
+    //! build tree and splitter array from sample, then the lookup table if the
+    //! sample's prefixes qualify.
+    void build(key_type* samples, size_t samplesize,
+               unsigned char* splitter_lcp)
+    {
+        Super::build(samples, samplesize, splitter_lcp);
+
+        for (size_t i = 0; i < numsplitters; ++i)
+            splitter[i] = Super::get_splitter(i);
+
+        prefix_rank.resize(lookup_size + 1);
+
+        size_t s = 0;
+        for (size_t p = 0; p <= lookup_size; ++p)
+        {
+            while (s < numsplitters && prefix(splitter[s]) < p) ++s;
+            prefix_rank[p] = s;
+        }
+
+        // the number of splitters sharing a key's prefix is the length of the
+        // search for it, estimate its average from the samples.
+        size_t search = 0;
+        for (size_t i = 0; i < samplesize; ++i)
+        {
+            unsigned int p = prefix(samples[i]);
+            search += prefix_rank[p + 1] - prefix_rank[p];
+        }
+
+        if (search > max_search * samplesize)
+            prefix_rank.clear();
+    }
+};
+
+template <size_t TreeBits>
+using ClassifyRadixLookupX = ClassifyRadixLookup<TreeBits>;
+
+} // namespace bingmann_sample_sort
+
+#endif // !PSS_SRC_SEQUENTIAL_BINGMANN_SAMPLE_SORTRL_HEADER
+
+/******************************************************************************/
@@ -31,10 +31,12 @@ namespace bingmann_sample_sort {
 
 //! Iterative TreeBuilder, constructs only a pre-order array of splitters and
 //! the corresponding LCPs - used only in the slow binary-search variants.
-template <size_t numsplitters>
+template <size_t numsplitters, typename KeyType = key_type>
 class TreeBuilderPreorder
 {
 public:
+    typedef KeyType key_type;
+
     TreeBuilderPreorder(
         key_type splitter[numsplitters],
         unsigned char splitter_lcp[numsplitters + 1],
@@ -63,10 +65,12 @@ public:
 //! Recursive TreeBuilder for full-descent and unrolled variants, constructs a
 //! both a pre-order and level-order array of splitters and the corresponding
 //! LCPs.
-template <size_t numsplitters>
+template <size_t numsplitters, typename KeyType = key_type>
 class TreeBuilderPreAndLevelOrder
 {
 public:
+    typedef KeyType key_type;
+
     key_type* m_splitter;
     key_type* m_tree;
     unsigned char* m_lcp_iter;
@@ -149,10 +153,12 @@ public:
 
 //! Recursive TreeBuilder for full-descent and unrolled variants, constructs
 //! only a level-order binary tree of splitters
-template <size_t numsplitters>
+template <size_t numsplitters, typename KeyType = key_type>
 class TreeBuilderLevelOrder
 {
 public:
+    typedef KeyType key_type;
+
     key_type* m_tree;
     unsigned char* m_lcp_iter;
     const key_type* m_samples;
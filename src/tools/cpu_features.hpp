@@ -0,0 +1,229 @@
+/*******************************************************************************
+ * src/tools/cpu_features.hpp
+ *
+ * Runtime detection of CPU instruction set levels for kernel dispatch, and of
+ * the data cache sizes for tuning the splitter tree size.
+ *
+ *******************************************************************************
+ * Copyright (C) 2017 Timo Bingmann <tb@panthema.net>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PSS_SRC_TOOLS_CPU_FEATURES_HEADER
+#define PSS_SRC_TOOLS_CPU_FEATURES_HEADER
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+//! whether the compiler can build x86 kernels for several instruction sets in
+//! one binary using target attributes.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PSS_CPU_DISPATCH 1
+#else
+#define PSS_CPU_DISPATCH 0
+#endif
+
+#if PSS_CPU_DISPATCH
+
+#include <immintrin.h>
+
+//! function attributes to compile a kernel for an instruction set level
+#define PSS_TARGET_SSE42 \
+    __attribute__ ((target("sse4.2,popcnt")))
+#define PSS_TARGET_AVX2 \
+    __attribute__ ((target("avx2,bmi,bmi2,popcnt")))
+#define PSS_TARGET_AVX512 \
+    __attribute__ ((target("avx512f,avx512vl,avx512bw,avx512dq,avx2,bmi,bmi2,popcnt")))
+
+//! attribute for kernel entry points: inline all called functions into the
+//! kernel such that the generic code (key extraction, tree descent) is compiled
+//! for the entry point's instruction set.
+#define PSS_FLATTEN __attribute__ ((flatten))
+
+#endif // PSS_CPU_DISPATCH
+
+namespace cpu_features {
+
+//! instruction set levels for which kernels are built
+enum isa_level {
+    ISA_GENERIC = 0, ISA_SSE42 = 1, ISA_AVX2 = 2, ISA_AVX512 = 3
+};
+
+//! return the name of an instruction set level
+static inline const char * isa_name(isa_level l)
+{
+    switch (l) {
+    case ISA_SSE42: return "sse4.2";
+    case ISA_AVX2: return "avx2";
+    case ISA_AVX512: return "avx512";
+    default: return "generic";
+    }
+}
+
+//! detect the highest instruction set level supported by the CPU and OS
+static inline isa_level detect_isa()
+{
+#if PSS_CPU_DISPATCH
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") &&
+        __builtin_cpu_supports("popcnt"))
+        return ISA_AVX512;
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") &&
+        __builtin_cpu_supports("popcnt"))
+        return ISA_AVX2;
+
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        return ISA_SSE42;
+#endif
+    return ISA_GENERIC;
+}
+
+//! selected level, or -1 if not yet selected. Function-local static to have a
+//! single instance in the program.
+inline std::atomic<int>& selected_isa_storage()
+{
+    static std::atomic<int> level(-1);
+    return level;
+}
+
+//! select the instruction set level for the kernels (once) and return it
+inline isa_level select_isa()
+{
+    int l = selected_isa_storage().load(std::memory_order_relaxed);
+    if (l < 0) {
+        l = detect_isa();
+        selected_isa_storage().store(l, std::memory_order_relaxed);
+    }
+    return static_cast<isa_level>(l);
+}
+
+//! return the instruction set level the kernels run with, selects it on the
+//! first call.
+static inline isa_level selected_isa()
+{
+    int l = selected_isa_storage().load(std::memory_order_relaxed);
+    if (__builtin_expect(l >= 0, 1))
+        return static_cast<isa_level>(l);
+    return select_isa();
+}
+
+//! return the name of the instruction set level the kernels run with
+static inline const char * selected_isa_name()
+{
+    return isa_name(selected_isa());
+}
+
+//! pin the kernels to an instruction set level, e.g. for benchmarking. The
+//! level is clamped to the ones supported by the CPU; returns the new level.
+inline isa_level force_isa(isa_level l)
+{
+    isa_level max = detect_isa();
+    if (l > max) l = max;
+    selected_isa_storage().store(l, std::memory_order_relaxed);
+    return l;
+}
+
+//! undo force_isa(): select the best level again
+inline isa_level reset_isa()
+{
+    return force_isa(detect_isa());
+}
+
+/******************************************************************************/
+// Data Cache Sizes
+
+//! read the size of the level-th data or unified cache of cpu0 from sysfs,
+//! returns 0 if not available.
+static inline size_t read_sysfs_cache_size(unsigned level)
+{
+#if defined(__linux__)
+    for (unsigned index = 0; index < 8; ++index)
+    {
+        char path[128], buf[64];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu0/cache/index%u/", index);
+
+        std::string dir = path;
+        FILE* f;
+
+        if (!(f = fopen((dir + "level").c_str(), "r"))) break;
+        unsigned l = 0;
+        if (fscanf(f, "%u", &l) != 1) l = 0;
+        fclose(f);
+        if (l != level) continue;
+
+        if (!(f = fopen((dir + "type").c_str(), "r"))) continue;
+        if (!fgets(buf, sizeof(buf), f)) buf[0] = 0;
+        fclose(f);
+        if (strncmp(buf, "Data", 4) != 0 && strncmp(buf, "Unified", 7) != 0)
+            continue;
+
+        if (!(f = fopen((dir + "size").c_str(), "r"))) continue;
+        if (!fgets(buf, sizeof(buf), f)) buf[0] = 0;
+        fclose(f);
+
+        char* end;
+        size_t size = strtoul(buf, &end, 10);
+        if (*end == 'K') size *= 1024;
+        else if (*end == 'M') size *= 1024 * 1024;
+        return size;
+    }
+#else
+    (void)level;
+#endif
+    return 0;
+}
+
+//! detect the size of the level-th data cache (level = 1, 2 or 3) in bytes,
+//! returns 0 if it cannot be determined.
+static inline size_t detect_cache_size(unsigned level)
+{
+    long size = 0;
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+    if (level == 1) size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    else if (level == 2) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    else if (level == 3) size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    if (size > 0) return size;
+    return read_sysfs_cache_size(level);
+}
+
+//! return the size of the level-th data cache in bytes, detected once at the
+//! first call, or 0 if unknown.
+inline size_t cache_size(unsigned level)
+{
+    static const size_t sizes[4] = {
+        0, detect_cache_size(1), detect_cache_size(2), detect_cache_size(3)
+    };
+    return level < 4 ? sizes[level] : 0;
+}
+
+} // namespace cpu_features
+
+#endif // !PSS_SRC_TOOLS_CPU_FEATURES_HEADER
+
+/******************************************************************************/
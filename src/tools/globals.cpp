@@ -31,4 +31,13 @@ size_t g_numa_nodes;
 // argument -M, --memory, see tools/input.h
 std::string gopt_memory_type;
 
+// pin the splitter tree size of pS5 to this number of levels (0 = adaptive)
+size_t g_ps5_treebits = 0;
+
+// distance in strings of the software prefetches in the classifiers (0 = off)
+size_t g_prefetch_distance = 16;
+
+// carry the keys of the strings through the levels of pS5 in a key cache
+bool g_ps5_keycache = false;
+
 /******************************************************************************/
@@ -37,6 +37,15 @@ extern std::string gopt_memory_type;
 
 extern size_t g_small_sort;
 
+// pin the splitter tree size of pS5 to this number of levels (0 = adaptive)
+extern size_t g_ps5_treebits;
+
+// distance in strings of the software prefetches in the classifiers (0 = off)
+extern size_t g_prefetch_distance;
+
+// carry the keys of the strings through the levels of pS5 in a key cache
+extern bool g_ps5_keycache;
+
 #endif // !PSS_SRC_TOOLS_GLOBALS_HEADER
 
 /******************************************************************************/
@@ -39,17 +39,115 @@
 
 #include <tbb/concurrent_queue.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "../tools/globals.hpp"
+#include "../tools/lockfree.hpp"
+#include "../tools/objectpool.hpp"
+#include "../tools/threadpool.hpp"
 
 namespace jobqueue {
 
 static const bool debug_queue = false;
 
+//! range of the adaptive number of failed pops an idle thread spins before it
+//! parks until a job is enqueued.
+static const unsigned spin_limit_min = 16;
+static const unsigned spin_limit_max = 4096;
+
+//! period after which a parked thread checks for other JobQueues of its group
+//! to assist, since their jobs do not wake it.
+static const std::chrono::microseconds park_assist_period(100);
+
+//! hint to the CPU that the calling thread is busy-waiting
+static inline void cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*!
+ * Token to cancel running jobs, optionally with a deadline after which it
+ * counts as cancelled. cancel() may be called from any thread, the jobs check
+ * cancelled() at their own boundaries and then return without finishing
+ * their work, such that the JobQueue drains quickly.
+ */
+class CancelToken
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    //! number of calls of poll() per thread between clock reads
+    static const unsigned poll_period = 64;
+
+    CancelToken()
+        : m_cancelled(false), m_has_deadline(false)
+    { }
+
+    explicit CancelToken(clock_type::time_point deadline)
+        : m_cancelled(false), m_has_deadline(true), m_deadline(deadline)
+    { }
+
+    //! non-copyable: jobs keep a pointer to the token
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator = (const CancelToken&) = delete;
+
+    //! request cancellation
+    void cancel()
+    {
+        m_cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    //! whether cancellation was requested or the deadline passed
+    bool cancelled() const
+    {
+        if (m_cancelled.load(std::memory_order_relaxed)) return true;
+
+        if (m_has_deadline && clock_type::now() >= m_deadline) {
+            m_cancelled.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    //! cheaper cancelled() for frequent checks in inner loops, which reads
+    //! the clock only on every poll_period-th call of a thread.
+    bool poll() const
+    {
+        if (m_cancelled.load(std::memory_order_relaxed)) return true;
+        if (!m_has_deadline) return false;
+
+        static thread_local unsigned calls = 0;
+        if (++calls % poll_period != 0) return false;
+
+        return cancelled();
+    }
+
+protected:
+    //! set by cancel() or once the deadline passed
+    mutable std::atomic<bool> m_cancelled;
+
+    //! whether m_deadline is valid
+    bool m_has_deadline;
+
+    //! deadline of the jobs
+    clock_type::time_point m_deadline;
+};
+
 // ****************************************************************************
 // *** Job and JobQueue system with lock-free queue and OpenMP threads
 
+//! Jobs are allocated either from an ObjectPool by "new (pool) Job", or from
+//! the system by "new Job", and both are freed by the JobQueue with delete.
 template <typename CookieType>
-class JobT
+class JobT : public objectpool::PooledObject
 {
 public:
     virtual ~JobT()
@@ -61,6 +159,233 @@ public:
     /// virtual function that is called by the JobQueue, delete object if run()
     /// returns true.
     virtual bool run(cookie_type& cookie) = 0;
+
+    /// estimated amount of work of the job, e.g. the number of strings it
+    /// sorts. Used by PriorityJobStorage to run the largest jobs first.
+    virtual size_t priority() const
+    {
+        return 0;
+    }
+};
+
+// ****************************************************************************
+// *** Job Storage of a JobQueue, selected by its JobQueueGroup
+
+//! Job storage with one lock-free FIFO queue shared by all threads.
+template <typename JobType>
+class SharedJobStorage
+{
+protected:
+    /// lock-free data structure containing pointers to Job objects.
+    tbb::concurrent_queue<JobType*> m_queue;
+
+public:
+    void push(JobType* job)
+    {
+        m_queue.push(job);
+    }
+
+    bool try_pop(JobType*& job)
+    {
+        return m_queue.try_pop(job);
+    }
+
+    //! called before threads 0 to nthreads - 1 work on the storage
+    void reserve_threads(size_t)
+    { }
+
+    //! called by each thread working on the storage before the first job
+    void attach_thread()
+    { }
+
+    //! approximate number of queued jobs
+    size_t size() const
+    {
+        return m_queue.unsafe_size();
+    }
+
+    bool empty() const
+    {
+        return m_queue.unsafe_size() == 0;
+    }
+};
+
+//! Job storage with a Chase-Lev deque per thread: threads push and pop their
+//! own jobs LIFO, such that freshly split subproblems are processed while hot
+//! in cache, and steal FIFO from the other threads, taking the oldest and
+//! usually largest jobs. Jobs enqueued by other threads, e.g. outside the
+//! parallel region or by threads of other JobQueues assisting this one, go to
+//! a shared injection queue.
+template <typename JobType>
+class WorkStealingJobStorage
+{
+protected:
+    typedef lockfree::chase_lev_deque<JobType*> deque_type;
+
+    //! one deque per thread
+    std::vector<std::unique_ptr<deque_type> > m_deques;
+
+    //! jobs enqueued by threads without a deque
+    tbb::concurrent_queue<JobType*> m_inject;
+
+    //! storage the calling thread was attached to
+    static WorkStealingJobStorage *& attached()
+    {
+        static thread_local WorkStealingJobStorage* storage = NULL;
+        return storage;
+    }
+
+    //! return the deque of the calling thread, or NULL.
+    deque_type * my_deque()
+    {
+        if (attached() != this) return NULL;
+        size_t tid = threadpool::thread_num();
+        return tid < m_deques.size() ? m_deques[tid].get() : NULL;
+    }
+
+public:
+    WorkStealingJobStorage()
+    {
+        int nthr = std::max(omp_get_max_threads(), 1);
+        for (int i = 0; i < nthr; ++i)
+            m_deques.emplace_back(new deque_type());
+    }
+
+    void push(JobType* job)
+    {
+        if (deque_type* d = my_deque())
+            d->push(job);
+        else
+            m_inject.push(job);
+    }
+
+    bool try_pop(JobType*& job)
+    {
+        deque_type* d = my_deque();
+        if (d && d->pop(job)) return true;
+
+        if (m_inject.try_pop(job)) return true;
+
+        // steal round-robin, starting after our own deque
+        size_t n = m_deques.size();
+        size_t tid = threadpool::thread_num();
+
+        for (size_t i = 1; i <= n; ++i)
+        {
+            deque_type* v = m_deques[(tid + i) % n].get();
+            if (v == d) continue;
+
+            typename deque_type::steal_result r;
+            while ((r = v->steal(job)) == deque_type::STEAL_ABORT) { }
+
+            if (r == deque_type::STEAL_SUCCESS) return true;
+        }
+
+        return false;
+    }
+
+    //! called before threads 0 to nthreads - 1 work on the storage
+    void reserve_threads(size_t nthreads)
+    {
+        while (m_deques.size() < nthreads)
+            m_deques.emplace_back(new deque_type());
+    }
+
+    //! called by each thread working on the storage before the first job
+    void attach_thread()
+    {
+        attached() = this;
+    }
+
+    //! approximate number of queued jobs
+    size_t size() const
+    {
+        size_t n = m_inject.unsafe_size();
+        for (size_t i = 0; i < m_deques.size(); ++i)
+            n += m_deques[i]->size();
+        return n;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+};
+
+//! Job storage with a heap ordered by the jobs' priority(), such that the
+//! threads always take the largest pending job. Large subproblems are then
+//! started first and do not end up as the last job determining the makespan.
+//! The heap is protected by a mutex, which is held only for a push or pop.
+template <typename JobType>
+class PriorityJobStorage
+{
+protected:
+    //! heap entry: priority of the job, cached to not call priority() while
+    //! holding the lock, and the job.
+    typedef std::pair<size_t, JobType*> entry_type;
+
+    //! max-heap of jobs by priority
+    std::vector<entry_type> m_heap;
+
+    //! lock protecting m_heap
+    std::mutex m_mutex;
+
+    //! number of jobs in the heap, readable without the lock
+    std::atomic<size_t> m_size;
+
+    //! compare entries by priority only
+    static bool less(const entry_type& a, const entry_type& b)
+    {
+        return a.first < b.first;
+    }
+
+public:
+    PriorityJobStorage()
+        : m_size(0)
+    { }
+
+    void push(JobType* job)
+    {
+        entry_type e(job->priority(), job);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_heap.push_back(e);
+        std::push_heap(m_heap.begin(), m_heap.end(), less);
+        ++m_size;
+    }
+
+    bool try_pop(JobType*& job)
+    {
+        if (m_size.load(std::memory_order_relaxed) == 0) return false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_heap.empty()) return false;
+
+        std::pop_heap(m_heap.begin(), m_heap.end(), less);
+        job = m_heap.back().second;
+        m_heap.pop_back();
+        --m_size;
+        return true;
+    }
+
+    //! called before threads 0 to nthreads - 1 work on the storage
+    void reserve_threads(size_t)
+    { }
+
+    //! called by each thread working on the storage before the first job
+    void attach_thread()
+    { }
+
+    //! approximate number of queued jobs
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
 };
 
 template <typename CookieType>
@@ -82,9 +407,12 @@ public:
     /// typedef of JobQueueGroup
     typedef JobQueueGroupType<CookieType> jobqueuegroup_type;
 
+    /// typedef of job storage, selected by the JobQueueGroup
+    typedef typename jobqueuegroup_type::storage_type storage_type;
+
 private:
     /// lock-free data structure containing pointers to Job objects.
-    tbb::concurrent_queue<job_type*> m_queue;
+    storage_type m_queue;
 
     //! number of threads working on queue
     unsigned m_numthrs;
@@ -92,6 +420,23 @@ private:
     /// number of threads idle
     std::atomic<unsigned int> m_idle_count;
 
+    /// number of threads of other JobQueues running jobs of this one
+    std::atomic<unsigned int> m_assist_count;
+
+    //! number of failed pops an idle thread spins before parking, doubled if
+    //! a job arrived while spinning and halved when a thread parked.
+    std::atomic<unsigned int> m_spin_limit;
+
+    //! number of threads parked or about to park
+    std::atomic<unsigned int> m_parked;
+
+    //! incremented under m_park_mutex to wake parked threads
+    std::atomic<size_t> m_park_epoch;
+
+    //! mutex and condition variable of parked threads
+    std::mutex m_park_mutex;
+    std::condition_variable m_park_cv;
+
     //! reference to the cookie of this JobQueue
     cookie_type& m_cookie;
 
@@ -107,18 +452,25 @@ public:
         : m_queue(),
           m_numthrs(0),
           m_idle_count(0),
+          m_assist_count(0),
+          m_spin_limit(spin_limit_min),
+          m_parked(0),
+          m_park_epoch(0),
           m_cookie(cookie),
           m_group(group)
     { }
 
     bool has_idle() const
     {
-        return (m_idle_count.load(std::memory_order_relaxed) != 0);
+        return (m_idle_count.load(std::memory_order_relaxed) != 0) ||
+               m_group->has_idle();
     }
 
     void enqueue(job_type* job)
     {
         m_queue.push(job);
+        wake(false);
+        m_group->notify_enqueue();
     }
 
     void set_id(unsigned id)
@@ -126,25 +478,95 @@ public:
         m_id = id;
     }
 
-    //! try to run one jobs from the queue, returns false if queue is finished,
-    //! true if ran jobs or queue not finished.
+    //! approximate number of queued jobs
+    size_t queued() const
+    {
+        return m_queue.size();
+    }
+
+    //! whether all jobs are done: no job is queued, all threads are idle, and
+    //! no thread of another JobQueue is running one of our jobs.
+    bool finished() const
+    {
+        return m_idle_count == m_numthrs && m_assist_count == 0 &&
+               m_queue.empty();
+    }
+
+    //! try to run one job from the queue on a thread of another JobQueue,
+    //! returns true if it ran a job. The queue's threads do not terminate
+    //! while the job runs, as it may enqueue further jobs.
     bool try_run()
     {
         job_type* job = NULL;
 
-        if (!m_queue.try_pop(job))
-            return (m_idle_count != m_numthrs);
+        ++m_assist_count;
 
-        if (job->run(m_cookie))
+        bool ran = m_queue.try_pop(job);
+        if (ran && job->run(m_cookie))
             delete job;
 
-        return true;
+        // the queue's threads may be parked waiting for us to terminate
+        if (--m_assist_count == 0 && m_idle_count == m_numthrs)
+            wake(true);
+
+        return ran;
     }
 
-    inline void executeThreadWork()
+private:
+    //! whether all threads are idle and no other thread runs one of our jobs
+    bool all_idle() const
+    {
+        return m_idle_count == m_numthrs && m_assist_count == 0;
+    }
+
+    //! wake one or all parked threads, if any.
+    void wake(bool all)
+    {
+        // pairs with the fence in park(): either a parking thread sees the
+        // job or the state change, or we see it parking.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_parked.load(std::memory_order_relaxed) == 0) return;
+
+        {
+            std::unique_lock<std::mutex> lock(m_park_mutex);
+            ++m_park_epoch;
+        }
+        if (all)
+            m_park_cv.notify_all();
+        else
+            m_park_cv.notify_one();
+    }
+
+    //! park the idle calling thread until a job is enqueued or all threads are
+    //! idle. If timed, only for park_assist_period, to assist other JobQueues.
+    void park(bool timed)
+    {
+        size_t epoch = m_park_epoch;
+
+        ++m_parked;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (m_queue.empty() && !all_idle())
+        {
+            std::unique_lock<std::mutex> lock(m_park_mutex);
+            auto woken = [&]() { return m_park_epoch != epoch; };
+
+            if (timed)
+                m_park_cv.wait_for(lock, park_assist_period, woken);
+            else
+                m_park_cv.wait(lock, woken);
+        }
+
+        --m_parked;
+    }
+
+public:
+
+    inline void executeThreadWork(unsigned numthrs)
     {
         job_type* job = NULL;
-        m_numthrs = omp_get_num_threads();
+        m_numthrs = numthrs;
+        m_queue.attach_thread();
 
         while (true)
         {
@@ -154,18 +576,48 @@ public:
                     delete job;
             }
 
-            // no more jobs -> switch to idle
-            ++m_idle_count;
+            // no more jobs -> switch to idle, the last one wakes all parked
+            // threads to terminate.
+            if (++m_idle_count == m_numthrs && m_assist_count == 0)
+                wake(true);
+
+            unsigned spins = 0;
+            bool parked = false;
 
             while (!m_queue.try_pop(job))
             {
-                if ( //!m_group->assist(m_id) &&
-                    m_idle_count == m_numthrs)
+                if (all_idle())
                 {
                     // assist other JobQueues before terminating.
                     while (m_group->assist(m_id)) { }
                     return;
                 }
+
+                // assist other JobQueues while idle.
+                bool assisting = m_group->assist(m_id);
+
+                if (++spins < m_spin_limit.load(std::memory_order_relaxed)) {
+                    cpu_relax();
+                    continue;
+                }
+
+                // no job for a while: park instead of taking CPU time and SMT
+                // resources from the working threads.
+                if (!parked) {
+                    m_spin_limit.store(
+                        std::max(m_spin_limit / 2, spin_limit_min),
+                        std::memory_order_relaxed);
+                    parked = true;
+                }
+                park(assisting);
+                spins = 0;
+            }
+
+            if (!parked) {
+                // a job arrived while spinning: spin longer next time.
+                m_spin_limit.store(
+                    std::min(m_spin_limit * 2, spin_limit_max),
+                    std::memory_order_relaxed);
             }
 
             // got a new job -> not idle anymore
@@ -189,11 +641,32 @@ public:
                 numa_set_preferred(0);
             }
 
-            executeThreadWork();
+            executeThreadWork(omp_get_num_threads());
         }   // end omp parallel
 
 
-        assert(m_queue.unsafe_size() == 0);
+        assert(m_queue.empty());
+    }
+
+    //! process jobs with nthreads threads of an Executor, e.g. a resident
+    //! ThreadPool, instead of an OpenMP parallel region.
+    void loop(threadpool::Executor& executor, size_t nthreads)
+    {
+        if (nthreads > executor.size()) nthreads = executor.size();
+        if (nthreads == 0) nthreads = 1;
+
+        m_idle_count = 0;
+        m_queue.reserve_threads(nthreads);
+
+        executor.run(nthreads, [this, nthreads](size_t tid) {
+                         // thread_num() must return the executor's numbers
+                         int saved_tid = threadpool::pool_thread_num();
+                         threadpool::pool_thread_num() = tid;
+                         executeThreadWork(nthreads);
+                         threadpool::pool_thread_num() = saved_tid;
+                     });
+
+        assert(m_queue.empty());
     }
 
     void numaLoop(int numaNode, int numberOfThreads)
@@ -204,10 +677,10 @@ public:
             numa_run_on_node(numaNode);
             numa_set_preferred(numaNode);
 
-            executeThreadWork();
+            executeThreadWork(omp_get_num_threads());
         }   // end omp parallel
 
-        assert(m_queue.unsafe_size() == 0);
+        assert(m_queue.empty());
     }
 };
 
@@ -222,11 +695,88 @@ public:
     /// typedef of compatible Job
     typedef JobT<CookieType> job_type;
 
+    /// typedef of job storage
+    typedef SharedJobStorage<job_type> storage_type;
+
+public:
+    static inline bool assist(unsigned)
+    {
+        return false;
+    }
+
+    //! called after a job was enqueued
+    static inline void notify_enqueue()
+    { }
+
+    //! whether threads outside the JobQueue are idle
+    static inline bool has_idle()
+    {
+        return false;
+    }
+};
+
+//! Define JobQueueGroup for a single JobQueue with per-thread work-stealing
+//! deques instead of the shared queue.
+template <typename CookieType>
+class WorkStealingJobQueueGroup
+{
+public:
+    /// typedef of compatible JobQueue
+    typedef JobQueueT<CookieType, WorkStealingJobQueueGroup> jobqueue_type;
+
+    /// typedef of compatible Job
+    typedef JobT<CookieType> job_type;
+
+    /// typedef of job storage
+    typedef WorkStealingJobStorage<job_type> storage_type;
+
+public:
+    static inline bool assist(unsigned)
+    {
+        return false;
+    }
+
+    //! called after a job was enqueued
+    static inline void notify_enqueue()
+    { }
+
+    //! whether threads outside the JobQueue are idle
+    static inline bool has_idle()
+    {
+        return false;
+    }
+};
+
+//! Define JobQueueGroup for a single JobQueue which runs the jobs with the
+//! largest priority() first.
+template <typename CookieType>
+class PriorityJobQueueGroup
+{
+public:
+    /// typedef of compatible JobQueue
+    typedef JobQueueT<CookieType, PriorityJobQueueGroup> jobqueue_type;
+
+    /// typedef of compatible Job
+    typedef JobT<CookieType> job_type;
+
+    /// typedef of job storage
+    typedef PriorityJobStorage<job_type> storage_type;
+
 public:
     static inline bool assist(unsigned)
     {
         return false;
     }
+
+    //! called after a job was enqueued
+    static inline void notify_enqueue()
+    { }
+
+    //! whether threads outside the JobQueue are idle
+    static inline bool has_idle()
+    {
+        return false;
+    }
 };
 
 //! Define NumaJobQueueGroup to group JobQueue which assist each other when idle.
@@ -240,6 +790,9 @@ public:
     /// typedef of compatible Job
     typedef JobT<CookieType> job_type;
 
+    /// typedef of job storage
+    typedef SharedJobStorage<job_type> storage_type;
+
 protected:
     //! List of managed JobQueues.
     std::vector<jobqueue_type*> m_queues;
@@ -305,21 +858,280 @@ public:
         }
     }
 
-    //! called by JobQueue's when they want to assist other queues.
+    //! called by idle threads of JobQueue qid to assist other queues: runs one
+    //! job of the unfinished queue with the most queued jobs, which pops its
+    //! oldest and usually largest job. Returns false once all other queues are
+    //! finished.
     bool assist(unsigned qid)
     {
         unsigned id = qid;
+        bool unfinished = false;
+
+        jobqueue_type* best = NULL;
+        size_t best_queued = 0;
 
         for (unsigned i = 1; i < m_queues.size(); ++i)
         {
             // go through queues round-robin starting at own
             if (++id >= m_queues.size()) id = 0;
+
+            jobqueue_type* jq = m_queues[id];
+            if (jq->finished()) continue;
+            unfinished = true;
+
+            size_t queued = jq->queued();
+            if (queued > best_queued) {
+                best = jq;
+                best_queued = queued;
+            }
         }
 
+        if (best) best->try_run();
+
+        return unfinished;
+    }
+
+    //! called after a job was enqueued
+    static inline void notify_enqueue()
+    { }
+
+    //! whether threads outside the JobQueue are idle
+    static inline bool has_idle()
+    {
         return false;
     }
 };
 
+/*!
+ * Resident threads which run the jobs of any number of JobQueues that are
+ * attached while the threads run, e.g. of several asynchronous sorts. The
+ * JobQueues have no threads of their own: each pool thread repeatedly runs
+ * one job via try_run(), taking turns among the attached queues with queued
+ * jobs, such that a small sort is not held up by a large one. Once
+ * all jobs of a queue are done, it is detached and its Client::complete() is
+ * called on the pool thread. Idle pool threads park until a job is enqueued.
+ */
+class JobQueuePool
+{
+public:
+    //! interface of an attached JobQueue
+    class Client
+    {
+    public:
+        virtual ~Client() { }
+
+        //! run one job, returns false if none was queued
+        virtual bool try_run() = 0;
+
+        //! approximate number of queued jobs
+        virtual size_t queued() const = 0;
+
+        //! whether all jobs are done
+        virtual bool finished() const = 0;
+
+        //! called once after the client was detached, may delete the client
+        virtual void complete() = 0;
+
+    private:
+        //! number of pool threads running a job of this client
+        size_t m_users = 0;
+
+        friend class JobQueuePool;
+    };
+
+    //! start num_threads pool threads
+    explicit JobQueuePool(size_t num_threads = omp_get_max_threads())
+        : m_next(0), m_idle(0), m_epoch(0), m_terminate(false)
+    {
+        for (size_t tid = 0; tid < num_threads; ++tid)
+            m_threads.emplace_back(&JobQueuePool::worker, this, tid);
+    }
+
+    //! non-copyable: the threads keep a pointer to the pool
+    JobQueuePool(const JobQueuePool&) = delete;
+    JobQueuePool& operator = (const JobQueuePool&) = delete;
+
+    //! wait for all clients to complete, then stop the threads
+    ~JobQueuePool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv_detached.wait(lock, [this]() { return m_clients.empty(); });
+            m_terminate = true;
+            ++m_epoch;
+        }
+        m_cv.notify_all();
+
+        for (size_t i = 0; i < m_threads.size(); ++i)
+            m_threads[i].join();
+    }
+
+    //! number of pool threads
+    size_t size() const
+    {
+        return m_threads.size();
+    }
+
+    //! attach a client whose first jobs are enqueued
+    void attach(Client* client)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_clients.push_back(client);
+            ++m_epoch;
+        }
+        m_cv.notify_all();
+    }
+
+    //! wake a parked thread after a job was enqueued
+    void notify()
+    {
+        // pairs with the increment of m_idle before a thread looks for jobs.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_idle.load(std::memory_order_relaxed) == 0) return;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            ++m_epoch;
+        }
+        m_cv.notify_one();
+    }
+
+    //! whether pool threads are looking for jobs
+    bool has_idle() const
+    {
+        return m_idle.load(std::memory_order_relaxed) != 0;
+    }
+
+protected:
+    //! pool threads
+    std::vector<std::thread> m_threads;
+
+    //! mutex protecting the following fields
+    std::mutex m_mutex;
+
+    //! signaled to wake parked threads, and when a client was detached
+    std::condition_variable m_cv, m_cv_detached;
+
+    //! attached clients
+    std::vector<Client*> m_clients;
+
+    //! index of the client to look at first
+    size_t m_next;
+
+    //! number of threads looking for jobs or parked
+    std::atomic<unsigned> m_idle;
+
+    //! incremented to wake parked threads
+    size_t m_epoch;
+
+    //! set by the destructor
+    bool m_terminate;
+
+    //! main loop of pool thread tid
+    void worker(size_t tid)
+    {
+        threadpool::pool_thread_num() = tid;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true)
+        {
+            size_t epoch = m_epoch;
+            ++m_idle;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // next client with queued jobs, round-robin
+            Client* best = NULL;
+
+            for (size_t i = 0; i < m_clients.size(); ++i)
+            {
+                size_t k = (m_next + i) % m_clients.size();
+                if (m_clients[k]->queued() != 0) {
+                    best = m_clients[k];
+                    m_next = k + 1;
+                    break;
+                }
+            }
+
+            if (!best)
+            {
+                if (m_terminate) {
+                    --m_idle;
+                    return;
+                }
+
+                m_cv.wait(lock, [&]() { return m_epoch != epoch; });
+                --m_idle;
+                continue;
+            }
+
+            --m_idle;
+            ++best->m_users;
+
+            lock.unlock();
+            best->try_run();
+            lock.lock();
+
+            // the last thread leaving a finished client detaches it, no other
+            // thread can pick it afterwards.
+            if (--best->m_users == 0 && best->finished())
+            {
+                m_clients.erase(
+                    std::find(m_clients.begin(), m_clients.end(), best));
+
+                lock.unlock();
+                best->complete();
+                lock.lock();
+
+                m_cv_detached.notify_all();
+            }
+        }
+    }
+};
+
+//! Define JobQueueGroup for JobQueues without threads of their own, whose jobs
+//! are run by the threads of a JobQueuePool.
+template <typename CookieType>
+class AsyncJobQueueGroup
+{
+public:
+    /// typedef of compatible JobQueue
+    typedef JobQueueT<CookieType, AsyncJobQueueGroup> jobqueue_type;
+
+    /// typedef of compatible Job
+    typedef JobT<CookieType> job_type;
+
+    /// typedef of job storage
+    typedef SharedJobStorage<job_type> storage_type;
+
+protected:
+    //! pool running the jobs
+    JobQueuePool* m_pool;
+
+public:
+    explicit AsyncJobQueueGroup(JobQueuePool* pool)
+        : m_pool(pool)
+    { }
+
+    static inline bool assist(unsigned)
+    {
+        return false;
+    }
+
+    //! called after a job was enqueued: wake a pool thread
+    void notify_enqueue()
+    {
+        m_pool->notify();
+    }
+
+    //! whether threads of the pool are idle
+    bool has_idle() const
+    {
+        return m_pool->has_idle();
+    }
+};
+
 //! Define "standard" JobQueue, which passes a reference to itself as cookie
 //! parameter to each run() call.
 class JobQueue : public JobQueueT<JobQueue>
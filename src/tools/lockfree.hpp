@@ -23,6 +23,10 @@
 #ifndef PSS_SRC_TOOLS_LOCKFREE_HEADER
 #define PSS_SRC_TOOLS_LOCKFREE_HEADER
 
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
 namespace lockfree {
 
 template <unsigned MaxThreads>
@@ -113,6 +117,164 @@ public:
     }
 };
 
+/*!
+ * Chase-Lev work-stealing deque of trivially copyable items (usually
+ * pointers). The owning thread pushes and pops at the bottom (LIFO), any other
+ * thread steals from the top (FIFO). The ring buffer grows when full, replaced
+ * buffers are kept until destruction, since thieves may still read them.
+ *
+ * Implemented following N.M. Le, A. Pop, A. Cohen, F. Zappa Nardelli: "Correct
+ * and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013.
+ */
+template <typename Type>
+class chase_lev_deque
+{
+protected:
+    //! ring buffer of items, size is a power of two
+    struct Array
+    {
+        int64_t            size;
+        std::atomic<Type>* buffer;
+
+        explicit Array(int64_t s)
+            : size(s), buffer(new std::atomic<Type>[s])
+        { }
+
+        ~Array()
+        {
+            delete[] buffer;
+        }
+
+        Type get(int64_t i) const
+        {
+            return buffer[i & (size - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, const Type& x)
+        {
+            buffer[i & (size - 1)].store(x, std::memory_order_relaxed);
+        }
+    };
+
+    //! index of the top item, incremented by thieves and by the owner when
+    //! taking the last item. On its own cache-line.
+    std::atomic<int64_t> m_top;
+    char                 m_pad1[64 - sizeof(std::atomic<int64_t>)];
+
+    //! index one past the bottom item, written only by the owner
+    std::atomic<int64_t> m_bottom;
+    char                 m_pad2[64 - sizeof(std::atomic<int64_t>)];
+
+    //! current ring buffer
+    std::atomic<Array*>  m_array;
+
+    //! replaced ring buffers, owned by the owner thread
+    std::vector<Array*>  m_garbage;
+
+public:
+    //! result of steal()
+    enum steal_result { STEAL_EMPTY, STEAL_ABORT, STEAL_SUCCESS };
+
+    explicit chase_lev_deque(int64_t initial_size = 64)
+        : m_top(0), m_bottom(0), m_array(new Array(initial_size))
+    { }
+
+    //! non-copyable: thieves may hold pointers into the buffers
+    chase_lev_deque(const chase_lev_deque&) = delete;
+    chase_lev_deque& operator = (const chase_lev_deque&) = delete;
+
+    ~chase_lev_deque()
+    {
+        delete m_array.load(std::memory_order_relaxed);
+        for (Array* a : m_garbage) delete a;
+    }
+
+    //! push an item at the bottom, only called by the owner
+    void push(const Type& x)
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array* a = m_array.load(std::memory_order_relaxed);
+
+        if (b - t > a->size - 1)
+        {
+            // grow: copy live items into a buffer of twice the size
+            Array* na = new Array(2 * a->size);
+            for (int64_t i = t; i < b; ++i)
+                na->put(i, a->get(i));
+
+            m_garbage.push_back(a);
+            m_array.store(na, std::memory_order_release);
+            a = na;
+        }
+
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    //! pop the bottom item, only called by the owner. Returns false if the
+    //! deque is empty or the last item was stolen concurrently.
+    bool pop(Type& x)
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // deque was empty
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        x = a->get(b);
+
+        if (t == b)
+        {
+            // last item: race against thieves for it
+            bool won = m_top.compare_exchange_strong(
+                t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    //! steal the top item, called by any thread. Returns STEAL_ABORT if it
+    //! lost a race against another thief or the owner.
+    steal_result steal(Type& x)
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return STEAL_EMPTY;
+
+        Array* a = m_array.load(std::memory_order_acquire);
+        x = a->get(t);
+
+        if (!m_top.compare_exchange_strong(
+                t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            return STEAL_ABORT;
+
+        return STEAL_SUCCESS;
+    }
+
+    //! approximate number of items, exact if no thread is working
+    size_t size() const
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+};
+
 } // namespace lockfree
 
 #endif // !PSS_SRC_TOOLS_LOCKFREE_HEADER
@@ -0,0 +1,320 @@
+/*******************************************************************************
+ * src/tools/objectpool.hpp
+ *
+ * Pool allocator with per-thread free lists for short-lived job objects.
+ *
+ *******************************************************************************
+ * Copyright (C) 2013-2017 Timo Bingmann <tb@panthema.net>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PSS_SRC_TOOLS_OBJECTPOOL_HEADER
+#define PSS_SRC_TOOLS_OBJECTPOOL_HEADER
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "../tools/threadpool.hpp"
+
+namespace objectpool {
+
+/*!
+ * Pool of memory blocks in power-of-two size classes. Each thread has a local
+ * free list per size class, from which it allocates and to which it frees
+ * without synchronization. When a local list grows beyond two batches, one
+ * batch of blocks is moved to a shared depot, and a thread whose local list
+ * is empty takes a batch from the depot before calling malloc(). Hence blocks
+ * are recycled even if one thread creates the jobs and others run and delete
+ * them, and after a warm-up nearly all allocations are served without a
+ * malloc() call, with one lock per batch. A batch holds about batch_bytes,
+ * which bounds the memory held by the local lists.
+ *
+ * All blocks are returned to the system when the pool is destroyed, which
+ * requires that all objects were freed before.
+ *
+ * Threads are identified by threadpool::thread_slot(), such that threads of
+ * different OpenMP teams or ThreadPools never share a free list. Threads with
+ * slots beyond max_slots, and blocks larger than 2^max_class bytes, bypass
+ * the pool.
+ */
+class ObjectPool
+{
+public:
+    //! smallest and largest size class, as power of two
+    static const unsigned min_class = 6;
+    static const unsigned max_class = 21;
+    static const unsigned num_classes = max_class - min_class + 1;
+
+    //! approximate size of a batch of blocks moved to or from the depot
+    static const size_t batch_bytes = 64 * 1024;
+
+    //! maximum number of threads with free lists
+    static const size_t max_slots = 1024;
+
+    //! header in front of each block: the pool or NULL if the block bypasses
+    //! it, and the size class. Padded to keep the objects 16-byte aligned.
+    struct alignas(16) Header
+    {
+        ObjectPool* pool;
+        unsigned    sizeclass;
+    };
+
+    ObjectPool()
+    {
+        for (size_t i = 0; i < max_slots; ++i)
+            m_caches[i] = NULL;
+    }
+
+    //! non-copyable: blocks point to their pool
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator = (const ObjectPool&) = delete;
+
+    ~ObjectPool()
+    {
+        for (size_t i = 0; i < max_slots; ++i)
+        {
+            ThreadCache* tc = m_caches[i].load(std::memory_order_relaxed);
+            if (!tc) continue;
+
+            for (unsigned c = 0; c < num_classes; ++c)
+                free_list(tc->local[c]);
+            delete tc;
+        }
+
+        for (unsigned c = 0; c < num_classes; ++c)
+        {
+            for (size_t b = 0; b < m_depot[c].size(); ++b)
+                free_list(m_depot[c][b]);
+        }
+    }
+
+    //! allocate a block of size bytes, from the system if pool is NULL.
+    static void * allocate(ObjectPool* pool, size_t size)
+    {
+        unsigned c = min_class;
+        while (c <= max_class && (size_t(1) << c) < sizeof(Header) + size)
+            ++c;
+
+        ThreadCache* tc = (pool && c <= max_class) ? pool->cache() : NULL;
+        Header* h;
+
+        if (!tc) {
+            h = static_cast<Header*>(malloc(sizeof(Header) + size));
+            if (!h) throw std::bad_alloc();
+            pool = NULL;
+        }
+        else {
+            unsigned i = c - min_class;
+            ++tc->allocated;
+
+            if (!tc->local[i]) pool->take_batch(tc, i);
+
+            if (Block* b = tc->local[i]) {
+                tc->local[i] = b->next;
+                --tc->count[i];
+                h = reinterpret_cast<Header*>(b);
+            }
+            else {
+                ++tc->malloced;
+                h = static_cast<Header*>(malloc(size_t(1) << c));
+                if (!h) throw std::bad_alloc();
+            }
+        }
+
+        h->pool = pool;
+        h->sizeclass = c;
+        return h + 1;
+    }
+
+    //! free a block returned by allocate()
+    static void deallocate(void* ptr)
+    {
+        if (!ptr) return;
+
+        Header* h = static_cast<Header*>(ptr) - 1;
+        ObjectPool* pool = h->pool;
+        ThreadCache* tc = pool ? pool->cache() : NULL;
+
+        if (!tc) {
+            free(h);
+            return;
+        }
+
+        unsigned i = h->sizeclass - min_class;
+
+        // the Block overwrites the Header
+        Block* b = reinterpret_cast<Block*>(h);
+        b->next = tc->local[i];
+        tc->local[i] = b;
+
+        if (++tc->count[i] >= 2 * batch_size(i))
+            pool->put_batch(tc, i);
+    }
+
+    //! number of blocks allocated from the pool
+    size_t allocated() const
+    {
+        return sum(&ThreadCache::allocated);
+    }
+
+    //! number of blocks which needed a new malloc()
+    size_t malloced() const
+    {
+        return sum(&ThreadCache::malloced);
+    }
+
+protected:
+    //! free block, linked into a free list
+    struct Block
+    {
+        Block* next;
+    };
+
+    //! local free lists and counters of one thread
+    struct ThreadCache
+    {
+        Block* local[num_classes];
+        size_t count[num_classes];
+
+        size_t allocated, malloced;
+
+        ThreadCache() : allocated(0), malloced(0)
+        {
+            for (unsigned c = 0; c < num_classes; ++c)
+                local[c] = NULL, count[c] = 0;
+        }
+    };
+
+    //! free lists of the threads, created by their first allocation
+    std::atomic<ThreadCache*> m_caches[max_slots];
+
+    //! batches of free blocks of each size class, each a list of
+    //! batch_size(c) blocks
+    std::vector<Block*> m_depot[num_classes];
+
+    //! lock protecting m_depot
+    std::mutex m_depot_mutex;
+
+    //! number of blocks in a batch of size class index c
+    static size_t batch_size(unsigned c)
+    {
+        size_t n = batch_bytes >> (c + min_class);
+        return n ? n : 1;
+    }
+
+    //! return the calling thread's free lists, or NULL.
+    ThreadCache * cache()
+    {
+        size_t slot = threadpool::thread_slot();
+        if (slot >= max_slots) return NULL;
+
+        ThreadCache* tc = m_caches[slot].load(std::memory_order_relaxed);
+        if (!tc) {
+            tc = new ThreadCache();
+            m_caches[slot].store(tc, std::memory_order_relaxed);
+        }
+        return tc;
+    }
+
+    //! move a batch from the depot to the empty local list of size class c
+    void take_batch(ThreadCache* tc, unsigned c)
+    {
+        std::unique_lock<std::mutex> lock(m_depot_mutex);
+        if (m_depot[c].empty()) return;
+
+        tc->local[c] = m_depot[c].back();
+        tc->count[c] = batch_size(c);
+        m_depot[c].pop_back();
+    }
+
+    //! move the first batch of the local list of size class c to the depot
+    void put_batch(ThreadCache* tc, unsigned c)
+    {
+        size_t n = batch_size(c);
+
+        Block* batch = tc->local[c];
+        Block* last = batch;
+        for (size_t k = 1; k < n; ++k) last = last->next;
+
+        tc->local[c] = last->next;
+        tc->count[c] -= n;
+        last->next = NULL;
+
+        std::unique_lock<std::mutex> lock(m_depot_mutex);
+        m_depot[c].push_back(batch);
+    }
+
+    //! free all blocks of a list
+    static void free_list(Block* b)
+    {
+        while (b) {
+            Block* next = b->next;
+            free(b);
+            b = next;
+        }
+    }
+
+    //! sum a counter over all threads, call only while no thread allocates
+    size_t sum(size_t ThreadCache::* counter) const
+    {
+        size_t s = 0;
+        for (size_t i = 0; i < max_slots; ++i)
+        {
+            ThreadCache* tc = m_caches[i].load(std::memory_order_relaxed);
+            if (tc) s += tc->*counter;
+        }
+        return s;
+    }
+};
+
+/*!
+ * Base class of objects allocated from an ObjectPool with placement syntax
+ * "new (pool) T(...)", or from the system with plain "new T(...)". Both are
+ * freed with plain "delete", which finds the pool in the block's header.
+ */
+class PooledObject
+{
+public:
+    static void * operator new (size_t size, ObjectPool& pool)
+    {
+        return ObjectPool::allocate(&pool, size);
+    }
+
+    static void * operator new (size_t size)
+    {
+        return ObjectPool::allocate(NULL, size);
+    }
+
+    static void operator delete (void* ptr)
+    {
+        ObjectPool::deallocate(ptr);
+    }
+
+    //! called if a constructor throws
+    static void operator delete (void* ptr, ObjectPool&)
+    {
+        ObjectPool::deallocate(ptr);
+    }
+};
+
+} // namespace objectpool
+
+#endif // !PSS_SRC_TOOLS_OBJECTPOOL_HEADER
+
+/******************************************************************************/
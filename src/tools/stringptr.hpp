@@ -16,6 +16,9 @@
  * StringShadowLcpOutPtr      -> (string,shadow=lcp,output,size,flip)
  * StringShadowLcpCacheOutPtr -> (string,shadow=lcp,charcache,output,size,flip)
  *
+ * StringInPlacePtr           -> (string,size)
+ * StringInPlaceLcpPtr        -> (string,lcp,size)
+ *
  *******************************************************************************
  * Copyright (C) 2013-2014 Timo Bingmann <tb@panthema.net>
  * Copyright (C) 2013-2014 Andreas Eberle <email@andreas-eberle.com>
@@ -448,6 +451,9 @@ public:
     //! if we want to save the LCPs
     static const bool with_lcp = false;
 
+    //! whether the shadow array is the active array itself
+    static const bool in_place = false;
+
     //! return reference to the i-th lcp
     uintptr_t & lcp(size_t /* i */) const
     {
@@ -595,6 +601,9 @@ public:
     //! if we want to save the LCPs
     static const bool with_lcp = false;
 
+    //! whether the shadow array is the active array itself
+    static const bool in_place = false;
+
     //! return reference to the i-th lcp
     uintptr_t & lcp(size_t i) const { return sp.lcp(i); }
 
@@ -703,6 +712,9 @@ public:
     //! if we want to save the LCPs
     static const bool with_lcp = true;
 
+    //! whether the shadow array is the active array itself
+    static const bool in_place = false;
+
     //! return reference to the i-th lcp
     uintptr_t & lcp(size_t i) const
     {
@@ -818,6 +830,9 @@ public:
     //! if we want to save the LCPs
     static const bool with_lcp = true;
 
+    //! whether the shadow array is the active array itself
+    static const bool in_place = false;
+
     //! return reference to the i-th lcp
     uintptr_t & lcp(size_t i) const
     {
@@ -971,6 +986,100 @@ public:
 typedef StringShadowLcpCacheOutPtr<parallel_string_sorting::UCharStringSet>
     UCharStringShadowLcpCacheOutPtr;
 
+/******************************************************************************/
+
+//! Objectified string array pointer for in-place sorting without a shadow
+//! array: the shadow is the active array itself, hence flipping and copying
+//! back are no-ops and the strings never leave the original array.
+template <typename _StringSet>
+class StringInPlacePtr : public StringShadowPtr<_StringSet>
+{
+public:
+    typedef _StringSet StringSet;
+    typedef StringShadowPtr<_StringSet> Super;
+
+    using Super::size;
+    using Super::active;
+
+    //! constructor specifying the string array
+    explicit StringInPlacePtr(const StringSet& original)
+        : Super(original, original)
+    { }
+
+    //! whether the shadow array is the active array itself
+    static const bool in_place = true;
+
+    //! Advance pointer by given offset, return sub-array
+    StringInPlacePtr sub(size_t offset, size_t _size) const
+    {
+        assert(offset + _size <= size());
+        return StringInPlacePtr(active().subi(offset, offset + _size));
+    }
+
+    //! same as sub(), there is no other array to flip to.
+    StringInPlacePtr flip(size_t offset, size_t _size) const
+    {
+        return sub(offset, _size);
+    }
+
+    //! same as *this, there is no other array to flip to.
+    StringInPlacePtr flip() const { return *this; }
+
+    //! Return the original for this StringInPlacePtr, which is itself
+    StringInPlacePtr original() const { return *this; }
+
+    //! the strings are always in the original array
+    StringInPlacePtr copy_back() const { return *this; }
+};
+
+//! Objectified string array pointer and lcp array for in-place sorting
+//! without a shadow array.
+template <typename _StringSet>
+class StringInPlaceLcpPtr : public StringShadowLcpPtr<_StringSet>
+{
+public:
+    typedef _StringSet StringSet;
+    typedef StringShadowLcpPtr<_StringSet> Super;
+
+    using Super::size;
+    using Super::active;
+
+protected:
+    using Super::lcps_;
+
+public:
+    //! constructor specifying the string and lcp arrays
+    StringInPlaceLcpPtr(const StringSet& original, lcp_t* lcps)
+        : Super(original, original, lcps)
+    { }
+
+    //! whether the shadow array is the active array itself
+    static const bool in_place = true;
+
+    //! Advance pointers by given offset, return sub-array
+    StringInPlaceLcpPtr sub(size_t offset, size_t _size) const
+    {
+        assert(offset + _size <= size());
+        return StringInPlaceLcpPtr(active().subi(offset, offset + _size),
+                                   lcps_ + offset);
+    }
+
+    //! same as sub(), there is no other array to flip to.
+    StringInPlaceLcpPtr flip(size_t offset, size_t _size) const
+    {
+        return sub(offset, _size);
+    }
+
+    //! same as *this, there is no other array to flip to.
+    StringInPlaceLcpPtr flip() const { return *this; }
+
+    //! Return the original for this StringInPlaceLcpPtr, which is itself
+    StringInPlaceLcpPtr original() const { return *this; }
+
+    //! the strings are always in the original array
+    StringInPlaceLcpPtr copy_back() const { return *this; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 
 //! verify LCP array against sorted string array by scanning LCPs
@@ -46,6 +46,9 @@ namespace parallel_string_sorting {
 
 typedef uintptr_t lcp_t;
 
+//! gcc synthesised 128-bit datatype, same as stringtools::uint128_t
+typedef unsigned int uint128_t __attribute__ ((mode(TI)));
+
 /******************************************************************************/
 // CharIterator -> character group functions
 
@@ -229,6 +232,16 @@ public:
         return v;
     }
 
+    //! Return up to 16 characters of string s at iterator i packed into a
+    //! uint128 (only works correctly for 8-bit characters)
+    uint128_t get_char_uint128_simple(
+        const typename Traits::String& s, typename Traits::CharIterator i) const
+    {
+        uint64_t hi = get_char_uint64_simple(s, i);
+        if ((hi & 0xFF) == 0) return uint128_t(hi) << 64;
+        return (uint128_t(hi) << 64) | get_char_uint64_simple(s, i + 8);
+    }
+
     uint8_t get_uint8(const typename Traits::String& s, size_t depth) const
     {
         const StringSet& ss = *static_cast<const StringSet*>(this);
@@ -253,6 +266,29 @@ public:
         return get_char_uint64_simple(s, ss.get_chars(s, depth));
     }
 
+    uint128_t get_uint128(const typename Traits::String& s, size_t depth) const
+    {
+        const StringSet& ss = *static_cast<const StringSet*>(this);
+        return get_char_uint128_simple(s, ss.get_chars(s, depth));
+    }
+
+    //! \}
+
+    //! \name Prefetching
+    //! \{
+
+    //! Prefetch the String object if s refers to it via an extra indirection,
+    //! such that prefetch_chars() can follow it without a cache miss.
+    void prefetch_string(const typename Traits::String&) const
+    { }
+
+    //! Prefetch the characters of string s at depth.
+    void prefetch_chars(const typename Traits::String& s, size_t depth) const
+    {
+        const StringSet& ss = *static_cast<const StringSet*>(this);
+        __builtin_prefetch(&*ss.get_chars(s, depth));
+    }
+
     //! \}
 
     //! Subset this string set using begin and size range.
@@ -355,6 +391,17 @@ struct StringSetGetKeyHelper<uint64_t>
     }
 };
 
+template <>
+struct StringSetGetKeyHelper<uint128_t>
+{
+    template <typename StringSet>
+    static uint128_t get_key(const StringSet& ss,
+                             const typename StringSet::String& s, size_t depth)
+    {
+        return ss.get_uint128(s, depth);
+    }
+};
+
 template <typename Type, typename StringSet>
 Type get_key(const StringSet& ss,
              const typename StringSet::String& s, size_t depth)
@@ -551,6 +598,10 @@ public:
     CharIterator get_chars(const String& s, size_t depth) const
     { return s.begin() + depth; }
 
+    //! Prefetch the characters of string s at depth.
+    void prefetch_chars(const String& s, size_t depth) const
+    { __builtin_prefetch(s.data() + depth); }
+
     //! Returns true if CharIterator is at end of the given String
     bool is_end(const String& s, const CharIterator& i) const
     { return (i >= s.end()); }
@@ -635,6 +686,14 @@ public:
     CharIterator get_chars(const String& s, size_t depth) const
     { return s->begin() + depth; }
 
+    //! Prefetch the std::string object referenced by the unique_ptr.
+    void prefetch_string(const String& s) const
+    { __builtin_prefetch(s.get()); }
+
+    //! Prefetch the characters of string s at depth.
+    void prefetch_chars(const String& s, size_t depth) const
+    { __builtin_prefetch(s->data() + depth); }
+
     //! Returns true if CharIterator is at end of the given String
     bool is_end(const String& s, const CharIterator& i) const
     { return (i >= s->end()); }
@@ -832,6 +891,10 @@ public:
     CharIterator get_chars(const String& s, size_t depth) const
     { return text_->begin() + s + depth; }
 
+    //! Prefetch the characters of string s at depth.
+    void prefetch_chars(const String& s, size_t depth) const
+    { __builtin_prefetch(text_->data() + s + depth); }
+
     //! Returns true if CharIterator is at end of the given String
     bool is_end(const String&, const CharIterator& i) const
     { return (i >= text_->end()); }
@@ -287,9 +287,8 @@ inline int count_high_zero_bits<uint128_t>(const uint128_t& t)
 {
     if (t == 0) return sizeof(t) * 8;
     uint64_t hi = (t >> 64);
-    int b = __builtin_clzll(hi);
-    if (b > 0)
-        return b;
+    if (hi != 0)
+        return __builtin_clzll(hi);
     else
         return 64 + __builtin_clzll((uint64_t)t);
 }
@@ -314,6 +313,17 @@ inline int count_low_zero_bits<uint64_t>(const uint64_t& t)
     return __builtin_ctzll(t);
 }
 
+template <>
+inline int count_low_zero_bits<uint128_t>(const uint128_t& t)
+{
+    if (t == 0) return sizeof(t) * 8;
+    uint64_t lo = (uint64_t)t;
+    if (lo != 0)
+        return __builtin_ctzll(lo);
+    else
+        return 64 + __builtin_ctzll((uint64_t)(t >> 64));
+}
+
 //! Class to transform in-order to level-order indexes in a perfect binary tree
 template <size_t treebits>
 struct TreeCalculations
@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * src/tools/threadpool.hpp
+ *
+ * Executors running job queues: OpenMP parallel regions or a resident pool.
+ *
+ *******************************************************************************
+ * Copyright (C) 2013-2017 Timo Bingmann <tb@panthema.net>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef PSS_SRC_TOOLS_THREADPOOL_HEADER
+#define PSS_SRC_TOOLS_THREADPOOL_HEADER
+
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <omp.h>
+
+namespace threadpool {
+
+//! number of the calling thread inside ThreadPool::run(), or -1 outside. Not
+//! static, such that all translation units share the thread-local variable.
+inline int& pool_thread_num()
+{
+    static thread_local int tid = -1;
+    return tid;
+}
+
+//! number of the calling thread in the running ThreadPool::run() or OpenMP
+//! parallel region, used to index per-thread data.
+inline size_t thread_num()
+{
+    int tid = pool_thread_num();
+    return tid >= 0 ? tid : omp_get_thread_num();
+}
+
+//! Registry handing out small numbers to the live threads, freed numbers are
+//! reused by new threads.
+class ThreadSlots
+{
+public:
+    size_t acquire()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_free.empty()) return m_next++;
+        size_t slot = m_free.back();
+        m_free.pop_back();
+        return slot;
+    }
+
+    void release(size_t slot)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_free.push_back(slot);
+    }
+
+protected:
+    std::mutex m_mutex;
+    std::vector<size_t> m_free;
+    size_t m_next = 0;
+};
+
+//! slot number of a thread, released when the thread exits
+struct ThreadSlot
+{
+    size_t slot;
+
+    //! the registry is never destroyed, as threads may exit after static
+    //! destruction.
+    static ThreadSlots& slots()
+    {
+        static ThreadSlots* slots = new ThreadSlots;
+        return *slots;
+    }
+
+    ThreadSlot() : slot(slots().acquire()) { }
+    ~ThreadSlot() { slots().release(slot); }
+};
+
+//! number of the calling thread which is unique among all live threads of the
+//! process, contrary to thread_num(), which is only unique within a thread
+//! team. Used to index per-thread data that threads of several teams access.
+inline size_t thread_slot()
+{
+    static thread_local ThreadSlot slot;
+    return slot.slot;
+}
+
+/*!
+ * Executor concept: runs a job on a number of threads and returns when all
+ * have finished. Job queues are processed by an Executor, hence applications
+ * which own a thread pool can derive from this class to run the sorts on
+ * their threads, instead of nesting OpenMP parallel regions in them.
+ */
+class Executor
+{
+public:
+    //! job run by each participating thread, called with its thread number
+    typedef std::function<void(size_t)> job_type;
+
+    virtual ~Executor() { }
+
+    //! maximum number of threads of run()
+    virtual size_t size() const = 0;
+
+    //! run job on nthreads <= size() threads with thread numbers 0 to
+    //! nthreads - 1, which may include the calling thread. Returns when all
+    //! have finished. The threads must be distinct and run concurrently,
+    //! since the job waits for the others.
+    virtual void run(size_t nthreads, const job_type& job) = 0;
+};
+
+//! Executor running jobs in an OpenMP parallel region.
+class OpenMPExecutor : public Executor
+{
+public:
+    size_t size() const final
+    {
+        return omp_get_max_threads();
+    }
+
+    void run(size_t nthreads, const job_type& job) final
+    {
+#pragma omp parallel num_threads(nthreads)
+        job(omp_get_thread_num());
+    }
+};
+
+/*!
+ * Executor with resident std::threads which are parked on a condition variable
+ * between calls of run(). Contrary to an OpenMP parallel region, the threads
+ * and their thread-local state survive until the pool is destroyed, hence
+ * repeated short parallel phases only pay for waking the threads.
+ *
+ * run() is not reentrant: only one thread may call it at a time.
+ */
+class ThreadPool : public Executor
+{
+public:
+    //! start a pool of num_threads threads including the caller of run(),
+    //! hence num_threads - 1 workers.
+    explicit ThreadPool(size_t num_threads = omp_get_max_threads())
+        : m_job(NULL), m_generation(0), m_nthreads(0), m_running(0),
+          m_terminate(false)
+    {
+        for (size_t tid = 1; tid < num_threads; ++tid)
+            m_threads.emplace_back(&ThreadPool::worker, this, tid);
+    }
+
+    //! non-copyable: workers keep a pointer to the pool
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_terminate = true;
+        }
+        m_cv_start.notify_all();
+
+        for (size_t i = 0; i < m_threads.size(); ++i)
+            m_threads[i].join();
+    }
+
+    //! number of threads including the caller of run()
+    size_t size() const final
+    {
+        return m_threads.size() + 1;
+    }
+
+    //! run job on nthreads threads: the calling thread as thread 0, and the
+    //! workers 1 to nthreads - 1. Returns when all have finished.
+    void run(size_t nthreads, const job_type& job) final
+    {
+        if (nthreads > size()) nthreads = size();
+
+        if (nthreads > 1)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_job = &job;
+                m_nthreads = nthreads;
+                m_running = nthreads - 1;
+                ++m_generation;
+            }
+            m_cv_start.notify_all();
+        }
+
+        int saved_tid = pool_thread_num();
+        pool_thread_num() = 0;
+        job(0);
+        pool_thread_num() = saved_tid;
+
+        if (nthreads > 1)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv_done.wait(lock, [this]() { return m_running == 0; });
+            m_job = NULL;
+        }
+    }
+
+protected:
+    //! worker threads 1 to size() - 1
+    std::vector<std::thread> m_threads;
+
+    //! mutex protecting the following fields
+    std::mutex m_mutex;
+
+    //! signaled to start a run() or terminate, and when a run() is done
+    std::condition_variable m_cv_start, m_cv_done;
+
+    //! job of the current run()
+    const job_type* m_job;
+
+    //! number of run() calls, workers wait for it to change
+    size_t m_generation;
+
+    //! number of threads of the current run()
+    size_t m_nthreads;
+
+    //! number of workers still running the current job
+    size_t m_running;
+
+    //! set by the destructor
+    bool m_terminate;
+
+    //! main loop of worker thread tid
+    void worker(size_t tid)
+    {
+        pool_thread_num() = tid;
+
+        size_t generation = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true)
+        {
+            m_cv_start.wait(lock, [&]() {
+                                return m_terminate || m_generation != generation;
+                            });
+            if (m_terminate) return;
+
+            generation = m_generation;
+            if (tid >= m_nthreads) continue;
+
+            const job_type* job = m_job;
+
+            lock.unlock();
+            (*job)(tid);
+            lock.lock();
+
+            assert(m_running > 0);
+            if (--m_running == 0)
+                m_cv_done.notify_one();
+        }
+    }
+};
+
+} // namespace threadpool
+
+#endif // !PSS_SRC_TOOLS_THREADPOOL_HEADER
+
+/******************************************************************************/
@@ -215,6 +215,15 @@ void TestStringSuffixString(
 static const char* letters_alnum
     = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
 
+//! all non-zero bytes, to get uniformly distributed leading key bits
+static std::string letters_bytes()
+{
+    std::string letters;
+    for (unsigned c = 1; c < 256; ++c)
+        letters += static_cast<char>(c);
+    return letters;
+}
+
 // use macro because one cannot pass template functions as template parameters:
 #define run_tests(func)                                           \
     TestUCharString(#func, func, nstrings, 16, letters_alnum);    \
@@ -232,10 +241,516 @@ void test_all(const size_t nstrings)
     run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_out_test);
     run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify);
     run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_out_lcp_verify);
+
+    // 128-bit key variant
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_base<
+                  bingmann_sample_sort::ClassifyTreeCalcUnrollInterleave128X>);
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+                  bingmann_sample_sort::ClassifyTreeCalcUnrollInterleave128X>);
+
+    // level-order tree with equality check at the leaf
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+                  bingmann_sample_sort::ClassifyEqualBranchlessX>);
+
+    // learned CDF model classifier
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+                  bingmann_sample_sort::ClassifyLearnedX>);
+
+    // radix lookup on the leading 16 bits, with tree fallback
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+                  bingmann_sample_sort::ClassifyRadixLookupX>);
+    TestUCharString(
+        "bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify",
+        bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+            bingmann_sample_sort::ClassifyRadixLookupX>,
+        nstrings, 16, letters_bytes());
+}
+
+//! run pS5 with each instantiated splitter tree size pinned
+void test_treebits(const size_t nstrings)
+{
+    using namespace bingmann_parallel_sample_sort;
+
+    for (size_t tb = g_treebits_min; tb <= g_treebits_max; tb += 2)
+    {
+        g_ps5_treebits = tb;
+        std::cout << "Using " << tb << " splitter tree levels" << std::endl;
+
+        run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify);
+    }
+
+    g_ps5_treebits = 0;
+}
+
+//! run pS5 with the key cache carried through the sort steps, with four
+//! threads to get parallel sample sort steps.
+void test_keycache(const size_t nstrings)
+{
+    int num_threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+    g_ps5_keycache = true;
+
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_base);
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify);
+
+    // equal keys to get recursive parallel sample sort steps
+    TestUCharString(
+        "bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify",
+        bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify,
+        nstrings, 12, "a");
+
+    g_ps5_keycache = false;
+    omp_set_num_threads(num_threads);
+}
+
+//! run pS5 with per-thread work-stealing deques, with eight threads to get
+//! steals.
+void test_workstealing(const size_t nstrings)
+{
+    int num_threads = omp_get_max_threads();
+    omp_set_num_threads(8);
+
+    run_tests((bingmann_parallel_sample_sort::parallel_sample_sort_base<
+                   bingmann_sample_sort::ClassifyRadixLookupX,
+                   jobqueue::WorkStealingJobQueueGroup>));
+    run_tests((bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+                   bingmann_sample_sort::ClassifyRadixLookupX,
+                   jobqueue::WorkStealingJobQueueGroup>));
+
+    omp_set_num_threads(num_threads);
+}
+
+//! run pS5 with the largest jobs first, with eight threads.
+void test_priority(const size_t nstrings)
+{
+    int num_threads = omp_get_max_threads();
+    omp_set_num_threads(8);
+
+    run_tests((bingmann_parallel_sample_sort::parallel_sample_sort_base<
+                   bingmann_sample_sort::ClassifyRadixLookupX,
+                   jobqueue::PriorityJobQueueGroup>));
+    run_tests((bingmann_parallel_sample_sort::parallel_sample_sort_lcp_verify<
+                   bingmann_sample_sort::ClassifyRadixLookupX,
+                   jobqueue::PriorityJobQueueGroup>));
+
+    omp_set_num_threads(num_threads);
+}
+
+//! persistent Sorter with four threads, reused by all following sorts
+template <template <typename> class JobQueueGroupType>
+bingmann_parallel_sample_sort::Sorter<
+    bingmann_sample_sort::ClassifyRadixLookupX, JobQueueGroupType>& sorter()
+{
+    static bingmann_parallel_sample_sort::Sorter<
+        bingmann_sample_sort::ClassifyRadixLookupX, JobQueueGroupType> s(4);
+    return s;
+}
+
+template <template <typename> class JobQueueGroupType, typename StringSet>
+void sorter_sort(const StringSet& strset, size_t depth)
+{
+    sorter<JobQueueGroupType>().sort_base(strset, depth);
+}
+
+template <template <typename> class JobQueueGroupType, typename StringSet>
+void sorter_lcp_verify(const StringSet& strset, size_t depth)
+{
+    std::vector<uintptr_t> tmp_lcp(strset.size());
+    tmp_lcp[0] = 42;                 // must keep lcp[0] unchanged
+    std::fill(tmp_lcp.begin() + 1, tmp_lcp.end(), -1);
+    sorter<JobQueueGroupType>().sort_lcp(strset, tmp_lcp.data(), depth);
+    die_unless(stringtools::verify_lcp(strset, tmp_lcp.data(), 42));
+}
+
+//! run repeated sorts of different sizes on the same persistent Sorters
+void test_sorter(const size_t nstrings)
+{
+    run_tests((sorter_sort<jobqueue::DefaultJobQueueGroup>));
+    run_tests((sorter_lcp_verify<jobqueue::DefaultJobQueueGroup>));
+    run_tests((sorter_lcp_verify<jobqueue::WorkStealingJobQueueGroup>));
+
+    // job and step objects are recycled by the following sorts
+    std::cout << "Sorter allocated "
+              << sorter<jobqueue::DefaultJobQueueGroup>().objects_allocated()
+              << " objects, "
+              << sorter<jobqueue::DefaultJobQueueGroup>().objects_malloced()
+              << " by malloc()" << std::endl;
+    die_unless(sorter<jobqueue::DefaultJobQueueGroup>().objects_malloced() <
+               sorter<jobqueue::DefaultJobQueueGroup>().objects_allocated());
+}
+
+//! AsyncSorter with four pool threads, shared by all async sorts
+bingmann_parallel_sample_sort::AsyncSorter<>& async_sorter()
+{
+    static bingmann_parallel_sample_sort::AsyncSorter<> s(4);
+    return s;
+}
+
+template <typename StringSet>
+void async_sort(const StringSet& strset, size_t depth)
+{
+    async_sorter().sort_base(strset, depth).get();
+}
+
+//! run async sorts one at a time, then several of skewed sizes in flight on
+//! the same pool threads.
+void test_async(const size_t nstrings)
+{
+    typedef unsigned char* string;
+
+    run_tests(async_sort);
+
+    static const unsigned numInputs = 4;
+    const size_t sizes[numInputs] = {
+        nstrings, nstrings / 4 + 1, nstrings / 64 + 1, 16
+    };
+
+    std::cout << "Running bingmann_parallel_sample_sort::AsyncSorter on "
+              << numInputs << " inputs of at most " << nstrings
+              << " uchar* strings in flight" << std::endl;
+
+    LCGRandom rng(1234567);
+
+    std::vector<std::vector<string> > input(numInputs);
+    std::vector<std::future<void> > done;
+
+    for (unsigned k = 0; k < numInputs; ++k)
+    {
+        input[k].resize(sizes[k]);
+
+        // generate random strings of length 16 to 19
+        for (size_t i = 0; i < sizes[k]; ++i)
+        {
+            size_t slen = 16 + (rng() >> 8) % 4;
+
+            input[k][i] = new unsigned char[slen + 1];
+            fill_random(rng, letters_alnum, input[k][i], input[k][i] + slen);
+            input[k][i][slen] = 0;
+        }
+
+        done.push_back(async_sorter().sort_base(
+                           UCharStringSet(input[k].data(),
+                                          input[k].data() + sizes[k])));
+    }
+
+    for (unsigned k = 0; k < numInputs; ++k)
+    {
+        done[k].get();
+
+        UCharStringSet strset(input[k].data(), input[k].data() + sizes[k]);
+        if (!strset.check_order()) {
+            std::cout << "Result is not sorted!" << std::endl;
+            abort();
+        }
+
+        for (size_t i = 0; i < sizes[k]; ++i)
+            delete[] input[k][i];
+    }
+}
+
+//! run segmented pS5 on many segments of random sizes 0 to 2047, and one
+//! segment of half the strings to get a parallel sort step.
+void test_segments(const size_t nstrings)
+{
+    typedef unsigned char* string;
+
+    LCGRandom rng(1234567);
+
+    std::vector<size_t> offsets(1, 0);
+    while (offsets.back() < nstrings)
+    {
+        size_t size = (offsets.size() == 8) ? nstrings / 2 : (rng() >> 8) % 2048;
+        offsets.push_back(std::min(offsets.back() + size, nstrings));
+    }
+    size_t nsegments = offsets.size() - 1;
+
+    std::cout << "Running bingmann_parallel_sample_sort::"
+              << "parallel_sample_sort_segments_base on " << nsegments
+              << " segments of " << nstrings << " uchar* strings" << std::endl;
+
+    // generate random strings of length 16 to 19
+    std::vector<string> input(nstrings);
+    for (size_t i = 0; i < nstrings; ++i)
+    {
+        size_t slen = 16 + (rng() >> 8) % 4;
+
+        input[i] = new unsigned char[slen + 1];
+        fill_random(rng, letters_alnum, input[i], input[i] + slen);
+        input[i][slen] = 0;
+    }
+
+    std::vector<string> expect = input;
+
+    bingmann_parallel_sample_sort::parallel_sample_sort_segments_base(
+        UCharStringSet(input.data(), input.data() + nstrings),
+        offsets.data(), nsegments, 0);
+
+    // each segment must be a sorted permutation of itself
+    for (size_t i = 0; i < nsegments; ++i)
+    {
+        std::sort(expect.begin() + offsets[i], expect.begin() + offsets[i + 1],
+                  [](string a, string b) {
+                      return strcmp((char*)a, (char*)b) < 0;
+                  });
+        for (size_t j = offsets[i]; j < offsets[i + 1]; ++j)
+        {
+            if (strcmp((char*)input[j], (char*)expect[j]) != 0) {
+                std::cout << "Segment " << i << " is not sorted!" << std::endl;
+                abort();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nstrings; ++i)
+        delete[] input[i];
+}
+
+//! run cancellable pS5 on std::string with the token cancelled after delay
+//! microseconds (-1 = never), and check that the result is a permutation.
+void test_cancel_after(const size_t nstrings, int delay, bool lcp,
+                       bool inplace = false)
+{
+    std::cout << "Running bingmann_parallel_sample_sort::parallel_sample_sort"
+              << " cancelled after " << delay << " us on " << nstrings
+              << " std::string" << std::endl;
+
+    LCGRandom rng(1234567);
+
+    std::vector<std::string> input(nstrings);
+    for (size_t i = 0; i < nstrings; ++i)
+    {
+        input[i].resize(16 + (rng() >> 8) % 4);
+        fill_random(rng, letters_alnum, input[i].begin(), input[i].end());
+    }
+
+    std::vector<std::string> expect = input;
+    std::sort(expect.begin(), expect.end());
+
+    jobqueue::CancelToken cancel;
+    std::thread canceller;
+    if (delay == 0) cancel.cancel();
+    else if (delay > 0)
+        canceller = std::thread([&]() {
+                                    std::this_thread::sleep_for(
+                                        std::chrono::microseconds(delay));
+                                    cancel.cancel();
+                                });
+
+    VectorStringSet strset(input.begin(), input.end());
+    VectorStringSet::Container shadow = strset.allocate(nstrings);
+    std::vector<uintptr_t> tmp_lcp(nstrings);
+
+    bool done;
+    if (inplace && lcp)
+        done = bingmann_parallel_sample_sort::parallel_sample_sort(
+            stringtools::StringInPlaceLcpPtr<VectorStringSet>(
+                strset, tmp_lcp.data()), 0, cancel);
+    else if (inplace)
+        done = bingmann_parallel_sample_sort::parallel_sample_sort(
+            stringtools::StringInPlacePtr<VectorStringSet>(strset), 0, cancel);
+    else if (lcp)
+        done = bingmann_parallel_sample_sort::parallel_sample_sort(
+            stringtools::StringShadowLcpPtr<VectorStringSet>(
+                strset, VectorStringSet(shadow), tmp_lcp.data()), 0, cancel);
+    else
+        done = bingmann_parallel_sample_sort::parallel_sample_sort(
+            stringtools::StringShadowPtr<VectorStringSet>(
+                strset, VectorStringSet(shadow)), 0, cancel);
+
+    VectorStringSet::deallocate(shadow);
+    if (canceller.joinable()) canceller.join();
+
+    std::cout << "Sort was " << (done ? "completed" : "cancelled")
+              << std::endl;
+    die_unless(done || delay >= 0);
+
+    if (done) {
+        die_unless(input == expect);
+    }
+    else {
+        // all strings must remain in the original array
+        std::sort(input.begin(), input.end());
+        die_unless(input == expect);
+    }
+}
+
+void test_cancel(const size_t nstrings)
+{
+    test_cancel_after(nstrings, -1, false);
+    test_cancel_after(nstrings, 0, false);
+    test_cancel_after(nstrings, 0, true);
+
+    for (int delay = 100; delay <= 100000; delay *= 10)
+    {
+        test_cancel_after(nstrings, delay, false);
+        test_cancel_after(nstrings, delay, true);
+    }
+
+    // a deadline in the past cancels immediately
+    jobqueue::CancelToken deadline(jobqueue::CancelToken::clock_type::now());
+    std::vector<unsigned char*> strings(nstrings);
+    die_unless(!bingmann_parallel_sample_sort::parallel_sample_sort_base(
+                   UCharStringSet(strings.data(), strings.data() + nstrings),
+                   0, deadline));
+}
+
+//! run pS5 in-place without shadow array, with four threads to get parallel
+//! sample sort steps and their block permutation.
+void test_inplace(const size_t nstrings)
+{
+    int num_threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_inplace_base);
+    run_tests(bingmann_parallel_sample_sort::parallel_sample_sort_inplace_lcp_verify);
+
+    // equal keys to get recursive parallel sample sort steps
+    TestUCharString(
+        "bingmann_parallel_sample_sort::parallel_sample_sort_inplace_lcp_verify",
+        bingmann_parallel_sample_sort::parallel_sample_sort_inplace_lcp_verify,
+        nstrings, 12, "a");
+
+    // the strings must be a permutation of the input, also if cancelled
+    test_cancel_after(nstrings, -1, true, true);
+    for (int delay = 0; delay <= 100000; delay = delay ? delay * 10 : 100)
+        test_cancel_after(nstrings, delay, false, true);
+
+    omp_set_num_threads(num_threads);
+}
+
+//! Executor starting new std::threads for each run, standing in for an
+//! application's own thread pool.
+class SpawnExecutor : public threadpool::Executor
+{
+public:
+    size_t size() const final
+    {
+        return 4;
+    }
+
+    void run(size_t nthreads, const job_type& job) final
+    {
+        std::vector<std::thread> threads;
+        for (size_t tid = 1; tid < nthreads; ++tid)
+            threads.emplace_back(job, tid);
+        job(0);
+        for (size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+};
+
+template <typename Executor, size_t nthreads,
+          template <typename> class JobQueueGroupType, typename StringSet>
+void executor_sort(const StringSet& strset, size_t depth)
+{
+    static Executor executor;
+    bingmann_parallel_sample_sort::parallel_sample_sort_base<
+        bingmann_sample_sort::ClassifyRadixLookupX, JobQueueGroupType>(
+        strset, depth, executor, nthreads);
+}
+
+//! run pS5 on the OpenMP, ThreadPool and an application Executor with
+//! thread budgets.
+void test_executor(const size_t nstrings)
+{
+    run_tests((executor_sort<threadpool::OpenMPExecutor, 3,
+                             jobqueue::DefaultJobQueueGroup>));
+    run_tests((executor_sort<threadpool::ThreadPool, 2,
+                             jobqueue::DefaultJobQueueGroup>));
+    run_tests((executor_sort<SpawnExecutor, 0,
+                             jobqueue::DefaultJobQueueGroup>));
+    run_tests((executor_sort<SpawnExecutor, 0,
+                             jobqueue::WorkStealingJobQueueGroup>));
+}
+
+//! run pS5 on inputs of skewed sizes with one NUMA job queue each, such that
+//! the threads of the queues with small inputs assist the others.
+void test_numa(const size_t nstrings)
+{
+    typedef unsigned char* string;
+
+    int num_threads = omp_get_max_threads();
+    omp_set_num_threads(6);
+
+    static const unsigned numInputs = 3;
+    const size_t sizes[numInputs] = { nstrings, nstrings / 16, nstrings / 256 };
+
+    std::cout << "Running bingmann_parallel_sample_sort::"
+              << "parallel_sample_sort_numa2 on " << numInputs
+              << " inputs of at most " << nstrings << " uchar* strings"
+              << std::endl;
+
+    LCGRandom rng(1234567);
+
+    std::vector<std::vector<string> > input(numInputs), output(numInputs);
+    std::vector<std::vector<uintptr_t> > lcps(numInputs);
+    std::vector<std::vector<unsigned char> > cache(numInputs);
+    std::vector<stringtools::UCharStringShadowLcpCacheOutPtr> strptr;
+
+    for (unsigned k = 0; k < numInputs; ++k)
+    {
+        size_t n = sizes[k];
+        input[k].resize(n), output[k].resize(n);
+        lcps[k].resize(n), cache[k].resize(n);
+
+        // generate random strings of length 16 to 19
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t slen = 16 + (rng() >> 8) % 4;
+
+            input[k][i] = new unsigned char[slen + 1];
+            fill_random(rng, letters_alnum, input[k][i], input[k][i] + slen);
+            input[k][i][slen] = 0;
+        }
+
+        UCharStringSet out(output[k].data(), output[k].data() + n);
+        strptr.emplace_back(
+            UCharStringSet(input[k].data(), input[k].data() + n), out, out,
+            lcps[k].data(), cache[k].data());
+    }
+
+    bingmann_parallel_sample_sort::parallel_sample_sort_numa2(
+        strptr.data(), numInputs);
+
+    for (unsigned k = 0; k < numInputs; ++k)
+    {
+        UCharStringSet out(output[k].data(), output[k].data() + sizes[k]);
+        if (!out.check_order()) {
+            std::cout << "Result is not sorted!" << std::endl;
+            abort();
+        }
+        die_unless(stringtools::verify_lcp_cache(
+                       output[k].data(), lcps[k].data(), cache[k].data(),
+                       sizes[k], 0));
+
+        for (size_t i = 0; i < sizes[k]; ++i)
+            delete[] output[k][i];
+    }
+
+    omp_set_num_threads(num_threads);
 }
 
 int main()
 {
+    test_treebits(2 * 1024 * 1024);
+    test_keycache(4 * 1024 * 1024);
+    test_workstealing(4 * 1024 * 1024);
+    test_priority(4 * 1024 * 1024);
+    test_numa(4 * 1024 * 1024);
+    test_sorter(16);
+    test_sorter(65550);
+    test_sorter(1024 * 1024);
+    test_async(16);
+    test_async(1024 * 1024);
+    test_segments(16);
+    test_segments(4 * 1024 * 1024);
+    test_cancel(16);
+    test_cancel(4 * 1024 * 1024);
+    test_executor(16);
+    test_executor(1024 * 1024);
+    test_inplace(16);
+    test_inplace(4 * 1024 * 1024 + 4321);
+
     test_all(16);
     test_all(256);
     test_all(65550);
@@ -23,6 +23,7 @@
 #include <sequential/bingmann-sample_sort.hpp>
 #include <tools/stringset.hpp>
 #include <tools/lcgrandom.hpp>
+#include <tools/cpu_features.hpp>
 
 template <typename Iterator>
 void fill_random(LCGRandom& rng, const std::string& letters,
@@ -91,13 +92,47 @@ void test_all(const size_t nstrings)
 
     run_tests(bingmann_sample_sort::bingmann_sample_sortBTCT);
     run_tests(bingmann_sample_sort::bingmann_sample_sortBTCTU);
+    run_tests(bingmann_sample_sort::bingmann_sample_sortBTCT128);
+    run_tests(bingmann_sample_sort::bingmann_sample_sortBTCTG);
 
     run_tests(bingmann_sample_sort::bingmann_sample_sortBTCE);
     run_tests(bingmann_sample_sort::bingmann_sample_sortBTCEA);
+    run_tests(bingmann_sample_sort::bingmann_sample_sortBTCEB);
+
+    run_tests(bingmann_sample_sort::bingmann_sample_sortKTC);
+    run_tests(bingmann_sample_sort::bingmann_sample_sortKTC16);
+
+    run_tests(bingmann_sample_sort::bingmann_sample_sortLC);
+    run_tests(bingmann_sample_sort::bingmann_sample_sortRL);
+}
+
+//! run classifiers with runtime kernel dispatch on all supported instruction
+//! set levels
+void test_isa_levels(const size_t nstrings)
+{
+    cpu_features::isa_level max = cpu_features::detect_isa();
+
+    for (int l = cpu_features::ISA_GENERIC; l <= max; ++l)
+    {
+        cpu_features::force_isa(static_cast<cpu_features::isa_level>(l));
+        std::cout << "Using " << cpu_features::selected_isa_name()
+                  << " kernels" << std::endl;
+
+        run_tests(bingmann_sample_sort::bingmann_sample_sortBTCTG);
+        run_tests(bingmann_sample_sort::bingmann_sample_sortKTC);
+        run_tests(bingmann_sample_sort::bingmann_sample_sortKTC16);
+    }
+
+    cpu_features::reset_isa();
 }
 
 int main()
 {
+    std::cout << "Detected " << cpu_features::isa_name(cpu_features::detect_isa())
+              << " instruction set" << std::endl;
+
+    test_isa_levels(65550);
+
     test_all(16);
     test_all(256);
     test_all(65550);